@@ -0,0 +1,63 @@
+#include "utils/profiling.h"
+#include <cstdint>
+#include <cxxopts.hpp>
+#include <iostream>
+#include <ostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include <utils/utils.h>
+#include <utils/mesh.h>
+#include <utils/mesh_io.h>
+
+// Converts OpenMesh formats (OBJ, PLY, OFF, STL) and .bmesh to OBJ, PLY or
+// .bmesh, the formats follow the file extensions.
+int main(int argc, char **argv) {
+    ASSERT(argc > 2, "Need [input file] [output file]");
+
+    cxxopts::Options options("cli", "CLI app to convert meshes to and from the binary format");
+    options.add_options()
+        ("i,input", "Input filename", cxxopts::value<std::string>())
+        ("o,output", "Output filename", cxxopts::value<std::string>())
+        ("adjacency", "Store the opposite corner table in .bmesh outputs",
+         cxxopts::value<bool>()->default_value("false"))
+        ("binary", "Write .ply outputs as binary PLY", cxxopts::value<bool>()->default_value("false"));
+
+    options.parse_positional({"input", "output"});
+    auto result = options.parse(argc, argv);
+
+    if(result.count("help")) {
+        printf("%s", options.help().c_str());
+        return 0;
+    }
+
+    ASSERT(result.count("input") >= 1 && result.count("output") >= 1, "Need [input file] [output file]");
+    const std::string INPUT           = result["input"].as<std::string>();
+    const std::string OUTPUT          = result["output"].as<std::string>();
+    const bool        ADJACENCY       = result["adjacency"].as<bool>();
+    const bool        BINARY_PLY      = result["binary"].as<bool>();
+
+    Mesh mesh;
+    {
+        PROFILING_SCOPE("Convert");
+
+        {
+            PROFILING_SCOPE("Import");
+            ASSERT(ReadMesh(mesh, INPUT), "Error in mesh import");
+        }
+        LOG_INFO("%s successfully imported: %lu vertices, %lu faces",
+                 INPUT.c_str(), mesh.n_vertices(), mesh.n_faces());
+
+        {
+            PROFILING_SCOPE("Export");
+            const bool ok = IsBinaryMeshPath(OUTPUT) ? WriteBinaryMesh(mesh, OUTPUT, ADJACENCY)
+                                                     : WriteMesh(mesh, OUTPUT, BINARY_PLY);
+            ASSERT(ok, "Error in mesh export!");
+        }
+        LOG_INFO("%s successfully exported", OUTPUT.c_str());
+    }
+
+    PROFILING_PRINT();
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include "utils/profiling.h"
+#include <cstdint>
+#include <cxxopts.hpp>
+#include <iostream>
+#include <ostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include <utils/utils.h>
+#include <utils/generate.h>
+#include <utils/mesh_writer.h>
+
+// Generates a procedural benchmark mesh (see generate.h) and optionally
+// exports it as OBJ, PLY or .bmesh, the format follows the extension.
+int main(int argc, char **argv) {
+    ASSERT(argc > 1, "Need [shape]");
+
+    cxxopts::Options options("cli", "CLI app to generate benchmark meshes");
+    options.add_options()
+        ("s,shape", "Shape: icosphere, terrain, torus or grid", cxxopts::value<std::string>())
+        ("n,faces", "Target faces, exact for grid", cxxopts::value<uint64_t>()->default_value("1048576"))
+        ("seed", "Seed of the noise and the torus holes", cxxopts::value<uint64_t>()->default_value("1"))
+        ("noise", "Random displacement relative to the edge length", cxxopts::value<float>()->default_value("0"))
+        ("holes", "Holes of the torus", cxxopts::value<uint32_t>()->default_value("8"))
+        ("o,output", "Output filename (.obj, .ply or .bmesh), none to only generate",
+         cxxopts::value<std::string>()->default_value(""))
+        ("binary", "Write .ply outputs as binary PLY", cxxopts::value<bool>()->default_value("false"));
+
+    options.parse_positional({"shape"});
+    auto result = options.parse(argc, argv);
+
+    if(result.count("help")) {
+        printf("%s", options.help().c_str());
+        return 0;
+    }
+
+    ASSERT(result.count("shape") >= 1, "Need [shape]");
+    const std::string SHAPE           = result["shape"].as<std::string>();
+    const std::string OUTPUT          = result["output"].as<std::string>();
+    const bool        BINARY_PLY      = result["binary"].as<bool>();
+
+    GeneratorOptions generator;
+    generator.mFaces = result["faces"].as<uint64_t>();
+    generator.mSeed  = result["seed"].as<uint64_t>();
+    generator.mNoise = result["noise"].as<float>();
+    generator.mHoles = result["holes"].as<uint32_t>();
+    ASSERT(ParseMeshShape(SHAPE, generator.mShape), "Unknown shape " + SHAPE);
+    ASSERT(OUTPUT.empty() || MeshFormatOf(OUTPUT) != MeshFormat::Other, "Unsupported output format " + OUTPUT);
+
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    {
+        PROFILING_SCOPE("Generate");
+
+        {
+            PROFILING_SCOPE(std::string("Build (") + MeshShapeName(generator.mShape) + ")");
+            GenerateMesh(generator, positions, indices);
+        }
+        LOG_INFO("%s generated: %zu vertices, %zu faces (seed %lu)", MeshShapeName(generator.mShape),
+                 positions.size() / 3, indices.size() / 3, generator.mSeed);
+
+        if (!OUTPUT.empty()) {
+            PROFILING_SCOPE("Export");
+            const bool ok = ExportMesh(OUTPUT, positions.data(), positions.size() / 3,
+                                       indices.data(), indices.size() / 3, MeshFormatOf(OUTPUT, BINARY_PLY));
+            ASSERT(ok, "Error in mesh export!");
+            LOG_INFO("%s successfully exported", OUTPUT.c_str());
+        }
+    }
+
+    PROFILING_PRINT();
+    return 0;
+}
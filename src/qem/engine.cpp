@@ -0,0 +1,25 @@
+#include "engine.h"
+#include "engines.h"
+
+template <template <typename, Placement> class EngineT>
+static std::unique_ptr<Engine> MakeEngineOf(const EngineOptions& options)
+{
+    std::unique_ptr<Engine> engine;
+    DispatchPlacement(options.mPlacement, [&](auto policy) {
+        constexpr Placement P = decltype(policy)::value;
+        if (options.mKernel == "flat")
+            engine = std::make_unique<EngineT<FlatMesh, P>>(options);
+        else if (options.mKernel == "openmesh")
+            engine = std::make_unique<EngineT<Mesh, P>>(options);
+    });
+    return engine;
+}
+
+std::unique_ptr<Engine> MakeEngine(const std::string& name, const EngineOptions& options)
+{
+    if (name == "seq")   return MakeEngineOf<SequentialEngine>(options);
+    if (name == "mp_v1") return MakeEngineOf<ParallelInitEngine>(options);
+    if (name == "mp_v2") return MakeEngineOf<ParallelForEngine>(options);
+    if (name == "mp_v3") return MakeEngineOf<BatchedEngine>(options);
+    return nullptr;
+}
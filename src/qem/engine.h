@@ -0,0 +1,92 @@
+#ifndef QEM_ENGINE_H
+#define QEM_ENGINE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <utils/curve_order.h>
+#include <utils/loop_stats.h>
+#include <utils/quadric.h>
+
+// In-process simplification engines, the qem library. An engine owns its
+// mesh: it is loaded from a file or from indexed triangles, Init computes
+// quadrics, errors and the heap, then Step / RunUntil collapse edges and
+// GetMesh / Save give the result back.
+//
+// Engines are profiled as children of the caller's PROFILING_SCOPE (the CLI
+// opens "CSG"), their OpenMP workers included, and PROFILING_PRINT is left
+// to the caller.
+
+struct EngineOptions {
+    std::string mKernel     = "openmesh";       // openmesh or flat
+    Placement   mPlacement  = Placement::Optimal;
+    CurveOrder  mCurve      = CurveOrder::None; // applied by Init
+    bool        mAccumulate = false;
+
+    // mp_v3 rounds: max collapses and max relative error over the round best edge
+    uint32_t    mBatchSize  = 4096;
+    double      mTolerance  = 0.5;
+};
+
+struct EngineStats {
+    std::size_t  mInitialFaces = 0;   // faces when Init ran
+    std::size_t  mFaces        = 0;   // faces left
+    uint64_t     mSteps        = 0;   // heap pops, rounds for mp_v3
+    uint64_t     mCollapses    = 0;
+    double       mInitMs       = 0.0;
+    double       mRunMs        = 0.0; // RunUntil only, Step is not timed
+    int          mThreads      = 1;   // OpenMP threads when Init ran
+    ReorderStats mReorder;            // estimated cache misses, zero without a curve
+    LoopStats    mLoop;               // counters of the collapse loop
+};
+
+// Reorder and loop counters as an indented text block for the profiling
+// report, and as a JSON object with the timeline as [ms, collapses] pairs
+std::string LoopStatsReport(const EngineStats& stats);
+std::string LoopStatsJson(const EngineStats& stats);
+
+class Engine {
+public:
+    virtual ~Engine() = default;
+
+    virtual const char* Name() const = 0;
+
+    // Replace the mesh, Init has to run before stepping
+    virtual bool Load(const std::string& path) = 0;
+    virtual void SetMesh(const float* positions, std::size_t nVertices,
+                         const uint32_t* indices, std::size_t nFaces) = 0;
+
+    virtual void Init() = 0;
+
+    // One unit of work (a heap pop, an independent batch for mp_v3), returns
+    // false once no edge is left to collapse.
+    virtual bool Step() = 0;
+
+    // Steps until the mesh has at most target faces or no edge is left
+    virtual void RunUntil(uint32_t target) = 0;
+
+    virtual EngineStats Stats() const = 0;
+
+    // Drops the deleted elements, element ids change so stepping again
+    // needs a new Init.
+    virtual void Compact() = 0;
+
+    virtual void GetMesh(std::vector<float>& positions, std::vector<uint32_t>& indices) const = 0;
+    virtual std::future<bool> Save(const std::string& path, bool binaryPly = false) const = 0;
+};
+
+// seq:   serial initialization and collapse loop
+// mp_v1: task-based initialization in one parallel region, serial collapse loop
+// mp_v2: parallel for initialization and re-scoring of the dirty edges
+// mp_v3: parallel batches of collapses with disjoint neighborhoods
+inline constexpr std::array<const char*, 4> ENGINE_NAMES = {"seq", "mp_v1", "mp_v2", "mp_v3"};
+
+// nullptr for an unknown engine or kernel
+std::unique_ptr<Engine> MakeEngine(const std::string& name, const EngineOptions& options = {});
+
+#endif // !QEM_ENGINE_H
@@ -0,0 +1,519 @@
+#ifndef QEM_ENGINES_H
+#define QEM_ENGINES_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <omp.h>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <utils/flat_mesh.h>
+#include <utils/mesh.h>
+#include <utils/mesh_io.h>
+#include <utils/profiling.h>
+#include <utils/reorder.h>
+#include <utils/simplify.h>
+
+#include "engine.h"
+
+// Engine backends, templated on the mesh kernel and the placement policy
+// and instantiated by MakeEngine (engine.cpp). The strategies only differ in
+// InitQuadrics and Advance, everything else lives in EngineBase.
+
+template <typename MeshT, Placement P>
+class EngineBase : public Engine {
+protected:
+    using Clock = std::chrono::steady_clock;
+
+    EngineOptions         mOptions;
+    MeshT                 mMesh;
+    EdgeHeap              mPq;
+    EngineStats           mStats;
+    std::size_t           mDeletedFaces = 0;
+    bool                  mReady        = false;
+    std::vector<uint32_t> mRemoved, mDirty;
+
+    inline std::size_t Faces() const { return NumFaces(mMesh) - mDeletedFaces; }
+
+    static inline double MillisecondsSince(const Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    // Face and vertex quadrics, edge errors and heap of the whole mesh,
+    // returns the edges whose optimal placement fell back
+    virtual uint64_t InitQuadrics() = 0;
+
+    // One unit of work without going under target faces, false when the
+    // heap is empty.
+    virtual bool Advance(uint32_t target) = 0;
+
+    inline void Reset()
+    {
+        PrepareMesh(mMesh);
+        mStats = {};
+        mStats.mFaces = NumFaces(mMesh);
+        mDeletedFaces = 0;
+        mReady = false;
+    }
+
+public:
+    explicit EngineBase(const EngineOptions& options) : mOptions(options) {}
+
+    bool Load(const std::string& path) override
+    {
+        if (!ReadMesh(mMesh, path)) return false;
+        Reset();
+        return true;
+    }
+
+    void SetMesh(const float* positions, const std::size_t nVertices,
+                 const uint32_t* indices, const std::size_t nFaces) override
+    {
+        BuildMeshFromArrays(mMesh, positions, nVertices, indices, nFaces);
+        Reset();
+    }
+
+    void Init() override
+    {
+        const auto start = Clock::now();
+        ReorderStats reorder;
+        if (mOptions.mCurve != CurveOrder::None) {
+            PROFILING_SCOPE(std::string("Reorder (") + CurveOrderName(mOptions.mCurve) + ")");
+            reorder = ReorderMesh(mMesh, mOptions.mCurve);
+            LOG_INFO("%s", reorder.Summary().c_str());
+        }
+
+        mPq.Resize(NumEdges(mMesh));
+        const uint64_t fallbacks = InitQuadrics();
+
+        mStats = {};
+        mStats.mInitialFaces = mStats.mFaces = NumFaces(mMesh);
+        mStats.mInitMs = MillisecondsSince(start);
+        mStats.mThreads = omp_get_max_threads();
+        mStats.mReorder = reorder;
+        mStats.mLoop.mInitFallbacks = fallbacks;
+        mStats.mLoop.mHeapPeak = mPq.Size();
+        mDeletedFaces = 0;
+        mReady = true;
+    }
+
+    bool Step() override
+    {
+        ASSERT(mReady, "Engine stepped before Init");
+        const bool more = Advance(0);
+        mStats.mFaces = Faces();
+        mStats.mLoop.mHeapPeak = std::max(mStats.mLoop.mHeapPeak, mPq.Size());
+        return more;
+    }
+
+    void RunUntil(const uint32_t target) override
+    {
+        ASSERT(mReady, "Engine stepped before Init");
+        PROFILING_SCOPE("Simplification Loop");
+        const auto start = Clock::now();
+        const uint64_t collapses = mStats.mCollapses;
+        uint64_t nextSample = collapses + LOOP_SAMPLE_COLLAPSES;
+        auto& timeline = mStats.mLoop.mTimeline;
+
+        while (Faces() > target && Advance(target)) {
+            mStats.mLoop.mHeapPeak = std::max(mStats.mLoop.mHeapPeak, mPq.Size());
+            if (mStats.mCollapses < nextSample) continue;
+
+            nextSample = mStats.mCollapses + LOOP_SAMPLE_COLLAPSES;
+            const double ms = mStats.mRunMs + MillisecondsSince(start);
+            if (timeline.empty() || ms - timeline.back().mMs >= LOOP_SAMPLE_MS)
+                timeline.push_back({ms, mStats.mCollapses});
+        }
+        PROFILING_ELEMENTS(mStats.mCollapses - collapses);
+
+        mStats.mFaces = Faces();
+        mStats.mRunMs += MillisecondsSince(start);
+        timeline.push_back({mStats.mRunMs, mStats.mCollapses});
+    }
+
+    EngineStats Stats() const override { return mStats; }
+
+    void Compact() override
+    {
+        CompactMesh(mMesh);
+        mDeletedFaces = 0;
+        mReady = false;
+    }
+
+    void GetMesh(std::vector<float>& positions, std::vector<uint32_t>& indices) const override
+    {
+        FlattenMesh(mMesh, positions, indices);
+    }
+
+    std::future<bool> Save(const std::string& path, const bool binaryPly) const override
+    {
+        return WriteMeshAsync(mMesh, path, binaryPly);
+    }
+};
+
+template <typename MeshT, Placement P>
+class SequentialEngine : public EngineBase<MeshT, P> {
+protected:
+    using Base = EngineBase<MeshT, P>;
+    using Base::mMesh, Base::mPq, Base::mStats, Base::mOptions, Base::mDeletedFaces, Base::mRemoved, Base::mDirty;
+
+    uint64_t InitQuadrics() override
+    {
+        PROFILING_SCOPE("Inizialization");
+        uint64_t fallbacks = 0;
+
+        {
+            PROFILING_SCOPE("Init-Faces-Quadric");
+            PROFILING_ELEMENTS(NumFaces(mMesh));
+            UpdateFaceQuadrics(mMesh, 0, NumFaces(mMesh));
+        }
+
+        {
+            PROFILING_SCOPE("Init-Vertices-Quadratic");
+            PROFILING_ELEMENTS(NumVertices(mMesh));
+            for (uint32_t i = 0; i < NumVertices(mMesh); ++i) {
+                UpdateVertexQuadric(mMesh, i);
+            }
+        }
+
+        {
+            PROFILING_SCOPE("Init-Edges-Quadric");
+            PROFILING_ELEMENTS(NumEdges(mMesh));
+            fallbacks = UpdateEdgeErrors<P>(mMesh, 0, NumEdges(mMesh));
+        }
+
+        {
+            PROFILING_SCOPE("Init-Edges-Heap");
+            PROFILING_ELEMENTS(NumEdges(mMesh));
+            mPq.Build(NumEdges(mMesh), [&](uint32_t i) {
+                return EdgeError(mMesh, i);
+            });
+        }
+        return fallbacks;
+    }
+
+    bool Advance(const uint32_t) override
+    {
+        if (mPq.Empty()) return false;
+
+        const uint32_t deletedFaces = CollapseBestEdge<P>(mMesh, mPq, mOptions.mAccumulate, mRemoved, mDirty,
+                                                          mStats.mLoop);
+        mDeletedFaces += deletedFaces;
+        mStats.mCollapses += deletedFaces > 0;
+        ++mStats.mSteps;
+        return true;
+    }
+
+public:
+    using Base::Base;
+    const char* Name() const override { return "seq"; }
+};
+
+// Every thread runs the whole initialization: one thread splits each loop
+// into tasks, the others run them while they wait at the end of the single
+// region, so every thread works inside its own profiling scopes. The heap
+// build is shared out with omp for.
+constexpr int INIT_TASKS_PER_THREAD = 8;
+
+template <typename MeshT, Placement P>
+class ParallelInitEngine : public SequentialEngine<MeshT, P> {
+protected:
+    using Base = SequentialEngine<MeshT, P>;
+    using Base::mMesh, Base::mPq;
+
+    uint64_t InitQuadrics() override
+    {
+        uint64_t fallbacks = 0;
+
+        #pragma omp parallel
+        {
+            PROFILING_SCOPE("Inizialization");
+            const int tasks = INIT_TASKS_PER_THREAD * omp_get_num_threads();
+
+            {
+                PROFILING_SCOPE("Init-Faces-Quadric");
+                #pragma omp single
+                {
+                    PROFILING_ELEMENTS(NumFaces(mMesh));
+                    #pragma omp taskloop num_tasks(tasks)
+                    for (int i = 0; i < NumFaces(mMesh); i += QUADRIC_BLOCK) {
+                        UpdateFaceQuadrics(mMesh, i, std::min<std::size_t>(i + QUADRIC_BLOCK, NumFaces(mMesh)));
+                    }
+                }
+            }
+
+            {
+                PROFILING_SCOPE("Init-Vertices-Quadratic");
+                #pragma omp single
+                {
+                    PROFILING_ELEMENTS(NumVertices(mMesh));
+                    #pragma omp taskloop num_tasks(tasks)
+                    for (int i = 0; i < NumVertices(mMesh); ++i) {
+                        UpdateVertexQuadric(mMesh, i);
+                    }
+                }
+            }
+
+            {
+                PROFILING_SCOPE("Init-Edges-Quadric");
+                #pragma omp single
+                {
+                    PROFILING_ELEMENTS(NumEdges(mMesh));
+                    #pragma omp taskloop num_tasks(tasks) reduction(+:fallbacks)
+                    for (int i = 0; i < NumEdges(mMesh); i += QUADRIC_BLOCK) {
+                        fallbacks += UpdateEdgeErrors<P>(mMesh, i, std::min<std::size_t>(i + QUADRIC_BLOCK, NumEdges(mMesh)));
+                    }
+                }
+            }
+
+            {
+                PROFILING_SCOPE("Init-Edges-Heap");
+                #pragma omp master
+                PROFILING_ELEMENTS(NumEdges(mMesh));
+                mPq.Build(NumEdges(mMesh), [&](uint32_t i) {
+                    return EdgeError(mMesh, i);
+                });
+            }
+        }
+        return fallbacks;
+    }
+
+public:
+    using Base::Base;
+    const char* Name() const override { return "mp_v1"; }
+};
+
+// Each initialization loop is its own parallel region, the collapse loop is
+// serial but re-scores the dirty edges of every collapse in parallel. The
+// init scopes are opened by every thread of the region, so their counters
+// cover all the workers.
+template <typename MeshT, Placement P>
+class ParallelForEngine : public EngineBase<MeshT, P> {
+protected:
+    using Base = EngineBase<MeshT, P>;
+    using Base::mMesh, Base::mPq, Base::mStats, Base::mOptions, Base::mDeletedFaces, Base::mRemoved, Base::mDirty;
+
+    uint64_t InitQuadrics() override
+    {
+        PROFILING_SCOPE("Inizialization");
+        uint64_t fallbacks = 0;
+
+        #pragma omp parallel
+        {
+            PROFILING_SCOPE("Init-Faces-Quadric");
+            #pragma omp master
+            PROFILING_ELEMENTS(NumFaces(mMesh));
+            #pragma omp for
+            for (int i = 0; i < NumFaces(mMesh); i += QUADRIC_BLOCK) {
+                UpdateFaceQuadrics(mMesh, i, std::min<std::size_t>(i + QUADRIC_BLOCK, NumFaces(mMesh)));
+            }
+        }
+
+        #pragma omp parallel
+        {
+            PROFILING_SCOPE("Init-Vertices-Quadratic");
+            #pragma omp master
+            PROFILING_ELEMENTS(NumVertices(mMesh));
+            #pragma omp for
+            for (int i = 0; i < NumVertices(mMesh); ++i) {
+                UpdateVertexQuadric(mMesh, i);
+            }
+        }
+
+        #pragma omp parallel
+        {
+            PROFILING_SCOPE("Init-Edges-Quadric");
+            #pragma omp master
+            PROFILING_ELEMENTS(NumEdges(mMesh));
+            #pragma omp for reduction(+:fallbacks)
+            for (int i = 0; i < NumEdges(mMesh); i += QUADRIC_BLOCK) {
+                fallbacks += UpdateEdgeErrors<P>(mMesh, i, std::min<std::size_t>(i + QUADRIC_BLOCK, NumEdges(mMesh)));
+            }
+        }
+
+        #pragma omp parallel
+        {
+            PROFILING_SCOPE("Init-Edges-Heap");
+            #pragma omp master
+            PROFILING_ELEMENTS(NumEdges(mMesh));
+            mPq.Build(NumEdges(mMesh), [&](uint32_t i) {
+                return EdgeError(mMesh, i);
+            });
+        }
+        return fallbacks;
+    }
+
+    bool Advance(const uint32_t) override
+    {
+        if (mPq.Empty()) return false;
+        ++mStats.mSteps;
+
+        const uint32_t e = mPq.Pop();
+        const CollapseCheck check = CheckCollapseEdge(mMesh, e);
+        mStats.mLoop.Pop(check);
+        if (check != CollapseCheck::Ok)
+            return true;
+
+        mDeletedFaces += 2 - IsBoundaryEdge(mMesh, e);
+        ++mStats.mCollapses;
+
+        mRemoved.clear();
+        const uint32_t v = CollapseEdge(mMesh, e, mRemoved);
+        for (auto ehd : mRemoved)
+            mPq.Remove(ehd);
+
+        mDirty.clear();
+        CollectDirtyEdges(mMesh, v, mOptions.mAccumulate, mDirty);
+
+        uint64_t fallbacks = 0;
+        #pragma omp parallel for reduction(+:fallbacks)
+        for (int i = 0; i < mDirty.size(); ++i) {
+            fallbacks += UpdateEdgeError<P>(mMesh, mDirty[i]);
+        }
+        mStats.mLoop.mFallbacks += fallbacks;
+        mStats.mLoop.mRescored += mDirty.size();
+
+        for (auto ehl : mDirty) {
+            if (IsEdgeLocked(mMesh, ehl)) continue;
+            mPq.Update(ehl, EdgeError(mMesh, ehl));
+        }
+        return true;
+    }
+
+public:
+    using Base::Base;
+    const char* Name() const override { return "mp_v2"; }
+};
+
+// Rounds of collapses popped in heap order within a tolerance of the round
+// best error, the ones with disjoint neighborhoods run in parallel and the
+// conflicting ones go back to the heap. The tolerance applies to at least
+// BATCH_ERROR_FLOOR of the mean initial edge error, so best keys near or
+// below zero (rounding, flat regions) don't shrink a round to one edge.
+constexpr double BATCH_ERROR_FLOOR = 1e-3;
+
+template <typename MeshT, Placement P>
+class BatchedEngine : public ParallelForEngine<MeshT, P> {
+protected:
+    using Base = ParallelForEngine<MeshT, P>;
+    using Base::mMesh, Base::mPq, Base::mStats, Base::mOptions, Base::mDeletedFaces;
+
+    uint32_t mRound = 0;
+    double mErrorFloor = 0.0;
+    std::vector<uint32_t> mStamps;
+    std::vector<uint32_t> mBatch;
+    std::vector<uint32_t> mDeferred;
+    std::vector<std::vector<uint32_t>> mRemovedEdges;
+    std::vector<std::vector<uint32_t>> mDirtyEdges;
+
+    uint64_t InitQuadrics() override
+    {
+        const uint64_t fallbacks = Base::InitQuadrics();
+
+        double sum = 0.0;
+        #pragma omp parallel for reduction(+:sum)
+        for (int e = 0; e < NumEdges(mMesh); ++e)
+            sum += std::fabs(double(EdgeError(mMesh, e)));
+        mErrorFloor = NumEdges(mMesh) > 0 ? BATCH_ERROR_FLOOR * sum / double(NumEdges(mMesh)) : 0.0;
+
+        mRound = 0;
+        mStamps.assign(NumVertices(mMesh), 0);
+        mRemovedEdges.clear();
+        mDirtyEdges.clear();
+        return fallbacks;
+    }
+
+    bool Advance(const uint32_t target) override
+    {
+        if (mPq.Empty()) return false;
+        ++mStats.mSteps;
+        ++mRound;
+        mBatch.clear();
+        mDeferred.clear();
+
+        const double bestError = mPq.TopKey();
+        const double threshold = bestError + mOptions.mTolerance * std::max(std::fabs(bestError), mErrorFloor);
+        const std::size_t batchSize = std::max<uint32_t>(mOptions.mBatchSize, 1);
+        int64_t remainingFaces = int64_t(this->Faces()) - target;
+
+        while (!mPq.Empty() && mBatch.size() < batchSize && remainingFaces > 0) {
+            if (!mBatch.empty() && mPq.TopKey() > threshold)
+                break;
+
+            const uint32_t e = mPq.Pop();
+
+            const CollapseCheck check = CheckCollapseEdge(mMesh, e);
+            mStats.mLoop.Pop(check);
+            if (check != CollapseCheck::Ok)
+                continue;
+
+            if (!ClaimCollapseNeighborhood(mMesh, e, mStamps, mRound)) {
+                mDeferred.push_back(e);
+                continue;
+            }
+
+            mBatch.push_back(e);
+            remainingFaces -= 2 - IsBoundaryEdge(mMesh, e);
+        }
+
+        for (auto e : mDeferred)
+            mPq.Update(e, EdgeError(mMesh, e));
+        mStats.mLoop.mDeferred += mDeferred.size();
+
+        std::size_t deletedFaces = 0;
+        uint64_t fallbacks = 0;
+        #pragma omp parallel
+        {
+            // Sized by the team, the thread count may change between rounds
+            #pragma omp single
+            {
+                mRemovedEdges.resize(omp_get_num_threads());
+                mDirtyEdges.resize(omp_get_num_threads());
+            }
+
+            auto& removed = mRemovedEdges[omp_get_thread_num()];
+            auto& dirty = mDirtyEdges[omp_get_thread_num()];
+            removed.clear();
+            dirty.clear();
+
+            #pragma omp for schedule(dynamic, 16) reduction(+:deletedFaces, fallbacks)
+            for (int i = 0; i < mBatch.size(); ++i) {
+                const uint32_t e = mBatch[i];
+                deletedFaces += 2 - IsBoundaryEdge(mMesh, e);
+                const uint32_t v = CollapseEdge(mMesh, e, removed);
+
+                const std::size_t first = dirty.size();
+                CollectDirtyEdges(mMesh, v, mOptions.mAccumulate, dirty);
+                fallbacks += UpdateEdgeErrors<P>(mMesh, std::span<const uint32_t>(dirty).subspan(first));
+            }
+        }
+        mDeletedFaces += deletedFaces;
+        mStats.mLoop.mFallbacks += fallbacks;
+
+        for (const auto& removed : mRemovedEdges) {
+            for (auto ehd : removed)
+                mPq.Remove(ehd);
+        }
+
+        for (const auto& dirty : mDirtyEdges) {
+            mStats.mLoop.mRescored += dirty.size();
+            for (auto ehl : dirty) {
+                if (IsEdgeLocked(mMesh, ehl)) continue;
+                mPq.Update(ehl, EdgeError(mMesh, ehl));
+            }
+        }
+
+        mStats.mCollapses += mBatch.size();
+        return true;
+    }
+
+public:
+    using Base::Base;
+    const char* Name() const override { return "mp_v3"; }
+};
+
+#endif // !QEM_ENGINES_H
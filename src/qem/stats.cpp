@@ -0,0 +1,83 @@
+#include "engine.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+static double Percent(const uint64_t part, const uint64_t whole)
+{
+    return whole > 0 ? 100.0 * double(part) / double(whole) : 0.0;
+}
+
+// Collapses per second between consecutive timeline samples
+static std::vector<double> TimelineRates(const std::vector<LoopSample>& timeline)
+{
+    std::vector<double> rates;
+    LoopSample previous;
+    for (const auto& sample : timeline) {
+        if (sample.mMs > previous.mMs)
+            rates.push_back(1000.0 * double(sample.mCollapses - previous.mCollapses) / (sample.mMs - previous.mMs));
+        previous = sample;
+    }
+    return rates;
+}
+
+std::string LoopStatsReport(const EngineStats& stats)
+{
+    const LoopStats& loop = stats.mLoop;
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(2);
+
+    oss << "[Loop Stats]: " << stats.mThreads << " threads, " << loop.mPops << " pops, "
+        << stats.mCollapses << " collapses";
+    if (stats.mRunMs > 0.0) oss << ", " << std::setprecision(0) << 1000.0 * stats.mCollapses / stats.mRunMs
+                                << " collapses/s" << std::setprecision(2);
+    oss << " \n";
+
+    if (stats.mReorder.mMissesBefore > 0)
+        oss << "\t[Reorder]: " << stats.mReorder.Summary() << " \n";
+    oss << "\t[Rejected]: " << loop.Rejected() << " (" << Percent(loop.Rejected(), loop.mPops) << " % of pops)";
+    for (std::size_t c = 1; c < COLLAPSE_CHECK_COUNT; ++c)
+        oss << (c == 1 ? ": " : ", ") << CollapseCheckName(static_cast<CollapseCheck>(c)) << " " << loop.mChecks[c];
+    oss << " \n";
+    oss << "\t[Stale Pops]: " << loop.Stale() << " (" << Percent(loop.Stale(), loop.mPops) << " % of pops) \n";
+    if (loop.mDeferred > 0)
+        oss << "\t[Deferred]: " << loop.mDeferred << " (" << Percent(loop.mDeferred, loop.mPops) << " % of pops) \n";
+
+    oss << "\t[Re-scored Edges]: " << loop.mRescored << " ("
+        << (stats.mCollapses > 0 ? double(loop.mRescored) / double(stats.mCollapses) : 0.0) << " per collapse) \n";
+    oss << "\t[Fallback Solves]: " << loop.mFallbacks << " (" << Percent(loop.mFallbacks, loop.mRescored)
+        << " % of re-scored), " << loop.mInitFallbacks << " at init \n";
+    oss << "\t[Heap Peak]: " << loop.mHeapPeak << " edges \n";
+
+    const std::vector<double> rates = TimelineRates(loop.mTimeline);
+    if (!rates.empty()) {
+        const auto [lo, hi] = std::minmax_element(rates.begin(), rates.end());
+        oss << std::setprecision(0) << "\t[Collapses/s]: first " << rates.front() << ", last " << rates.back()
+            << ", min " << *lo << ", max " << *hi << " over " << rates.size() << " intervals \n";
+    }
+
+    return oss.str();
+}
+
+std::string LoopStatsJson(const EngineStats& stats)
+{
+    const LoopStats& loop = stats.mLoop;
+    std::ostringstream oss;
+
+    oss << "{\"pops\": " << loop.mPops << ", \"collapses\": " << stats.mCollapses
+        << ", \"rejected\": " << loop.Rejected() << ", \"rejected_by\": {";
+    for (std::size_t c = 1; c < COLLAPSE_CHECK_COUNT; ++c)
+        oss << (c > 1 ? ", " : "") << "\"" << CollapseCheckName(static_cast<CollapseCheck>(c)) << "\": " << loop.mChecks[c];
+    oss << "}, \"stale_pops\": " << loop.Stale() << ", \"deferred\": " << loop.mDeferred
+        << ", \"rescored\": " << loop.mRescored << ", \"fallback_solves\": " << loop.mFallbacks
+        << ", \"init_fallback_solves\": " << loop.mInitFallbacks << ", \"heap_peak\": " << loop.mHeapPeak
+        << ", \"run_ms\": " << stats.mRunMs << ", \"threads\": " << stats.mThreads
+        << ", \"reorder_misses\": {\"before\": " << stats.mReorder.mMissesBefore
+        << ", \"after\": " << stats.mReorder.mMissesAfter << "}, \"timeline\": [";
+    for (std::size_t i = 0; i < loop.mTimeline.size(); ++i)
+        oss << (i ? ", " : "") << "[" << loop.mTimeline[i].mMs << ", " << loop.mTimeline[i].mCollapses << "]";
+    oss << "]}";
+
+    return oss.str();
+}
@@ -0,0 +1,354 @@
+#include "utils/profiling.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cxxopts.hpp>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include <qem/engine.h>
+#include <utils/bench.h>
+#include <utils/generate.h>
+#include <utils/utils.h>
+
+// Scaling benchmark of the simplification engines. Every engine runs over
+// every mesh, reduction ratio and OpenMP thread count, each configuration
+// with warm-up runs and timed repetitions. Results go to CSV (and JSON) so
+// runs of different commits can be compared, a previous CSV can be passed
+// as baseline to flag regressions of the median total time. Inputs are
+// files or generated meshes (generate.h), the latter skip disk I/O.
+
+struct BenchMesh {
+    std::string           mName;
+    std::vector<float>    mPositions;
+    std::vector<uint32_t> mIndices;
+};
+
+struct BenchResult {
+    std::string mMesh;
+    std::string mEngine;
+    std::string mRatio;     // as written to the CSV, part of the baseline key
+    int         mThreads    = 1;
+    std::size_t mFaces      = 0;
+    std::size_t mTarget     = 0;
+    std::size_t mFinalFaces = 0;
+    SampleStats mInit, mRun, mTotal;
+    std::string mLoop;      // LoopStatsJson of the last repetition
+
+    double      mBaselineMs = 0.0;
+    std::string mStatus     = "new";  // new, ok, improved or regression
+};
+
+static std::string FormatRatio(const double ratio)
+{
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%g", ratio);
+    return buffer;
+}
+
+static std::string BaselineKey(const std::string& mesh, const std::string& engine, const std::string& kernel,
+                               const std::string& placement, const std::string& scalar,
+                               const std::string& ratio, const std::string& threads)
+{
+    return mesh + "," + engine + "," + kernel + "," + placement + "," + scalar + "," + ratio + "," + threads;
+}
+
+// Fields of a CSV line, quoted fields as written by CsvString
+static std::vector<std::string> SplitCsvLine(const std::string& line)
+{
+    std::vector<std::string> fields(1);
+    bool quoted = false;
+    for (std::size_t i = 0; i < line.size(); ++i) {
+        const char c = line[i];
+        if (quoted && c == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+            fields.back() += line[++i];
+        } else if (c == '"') {
+            quoted = !quoted;
+        } else if (c == ',' && !quoted) {
+            fields.emplace_back();
+        } else if (c != '\r') {
+            fields.back() += c;
+        }
+    }
+    return fields;
+}
+
+// Median total time of every configuration of a CSV written by this tool,
+// a malformed row fails the read so no configuration is silently dropped
+static bool ReadBaseline(const std::string& path, std::map<std::string, double>& baseline)
+{
+    std::ifstream in(path);
+    if (!in) return false;
+
+    std::string line;
+    if (!std::getline(in, line)) return false;
+
+    std::map<std::string, std::size_t> column;
+    const auto header = SplitCsvLine(line);
+    for (std::size_t i = 0; i < header.size(); ++i)
+        column[header[i]] = i;
+
+    for (const char* name : {"mesh", "engine", "kernel", "placement", "scalar", "ratio", "threads", "total_median_ms"}) {
+        if (!column.count(name)) return false;
+    }
+
+    for (std::size_t number = 2; std::getline(in, line); ++number) {
+        if (line.empty()) continue;
+
+        const auto row = SplitCsvLine(line);
+        if (row.size() != header.size()) {
+            LOG_ERROR("%s:%zu: %zu fields, the header has %zu", path.c_str(), number, row.size(), header.size());
+            return false;
+        }
+
+        auto at = [&](const char* name) { return row[column[name]]; };
+        const std::string median = at("total_median_ms");
+        char* end = nullptr;
+        const double ms = std::strtod(median.c_str(), &end);
+        if (median.empty() || *end != '\0') {
+            LOG_ERROR("%s:%zu: bad total_median_ms '%s'", path.c_str(), number, median.c_str());
+            return false;
+        }
+
+        baseline[BaselineKey(at("mesh"), at("engine"), at("kernel"), at("placement"),
+                             at("scalar"), at("ratio"), at("threads"))] = ms;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    ASSERT(argc > 1, "Need [input files] or --generate");
+
+    cxxopts::Options options("cli", "CLI app to benchmark the simplification engines");
+    options.add_options()
+        ("i,input", "Input mesh filenames", cxxopts::value<std::vector<std::string>>())
+        ("g,generate", "Generated inputs as shape:faces[:seed], e.g. icosphere:1000000",
+         cxxopts::value<std::vector<std::string>>())
+        ("e,engines", "Engines to run (default: all)", cxxopts::value<std::vector<std::string>>())
+        ("r,ratios", "Target faces as fractions of the input faces",
+         cxxopts::value<std::vector<double>>()->default_value("0.5,0.1"))
+        ("t,threads", "OpenMP thread counts (default: 1 and the max)", cxxopts::value<std::vector<int>>())
+        ("n,repetitions", "Timed runs per configuration", cxxopts::value<uint32_t>()->default_value("5"))
+        ("w,warmup", "Untimed runs per configuration", cxxopts::value<uint32_t>()->default_value("1"))
+        ("k,kernel", "Mesh kernel: openmesh or flat", cxxopts::value<std::string>()->default_value("openmesh"))
+        ("p,placement", "Vertex placement of the collapses: optimal, endpoints or midpoint",
+         cxxopts::value<std::string>()->default_value("optimal"))
+        ("a,accumulate", "Keep accumulated quadrics and re-score only the edges of the surviving vertex",
+         cxxopts::value<bool>()->default_value("false"))
+        ("reorder", "Reorder vertices and faces along a space-filling curve: none, morton or hilbert",
+         cxxopts::value<std::string>()->default_value("none"))
+        ("csv", "CSV results filename", cxxopts::value<std::string>()->default_value("out/bench.csv"))
+        ("json", "JSON results filename", cxxopts::value<std::string>()->default_value(""))
+        ("label", "Free text stored with the results, e.g. the commit", cxxopts::value<std::string>()->default_value(""))
+        ("baseline", "CSV of a previous run to compare against", cxxopts::value<std::string>()->default_value(""))
+        ("regression", "Relative slowdown of the median total time flagged as a regression",
+         cxxopts::value<double>()->default_value("0.1"))
+        ("trace", "Chrome trace-event JSON of the profiling scopes (default: $QEM_TRACE)",
+         cxxopts::value<std::string>()->default_value(""));
+
+    options.parse_positional({"input"});
+    auto result = options.parse(argc, argv);
+
+    if(result.count("help")) {
+        printf("%s", options.help().c_str());
+        return 0;
+    }
+
+    ASSERT(result.count("input") + result.count("generate") >= 1, "Need [input files] or --generate");
+    const std::vector<double> RATIOS       = result["ratios"].as<std::vector<double>>();
+    const uint32_t    REPETITIONS          = result["repetitions"].as<uint32_t>();
+    const uint32_t    WARMUP               = result["warmup"].as<uint32_t>();
+    const std::string PLACEMENT            = result["placement"].as<std::string>();
+    const std::string REORDER              = result["reorder"].as<std::string>();
+    const std::string CSV                  = result["csv"].as<std::string>();
+    const std::string JSON                 = result["json"].as<std::string>();
+    const std::string LABEL                = result["label"].as<std::string>();
+    const std::string BASELINE             = result["baseline"].as<std::string>();
+    const double      REGRESSION           = result["regression"].as<double>();
+    const std::string TRACE                = result["trace"].as<std::string>();
+
+    if (!TRACE.empty()) ProfilingTraceTo(TRACE);
+
+    std::vector<std::string> engines(ENGINE_NAMES.begin(), ENGINE_NAMES.end());
+    if (result.count("engines"))
+        engines = result["engines"].as<std::vector<std::string>>();
+
+    std::vector<int> threads = {1, omp_get_max_threads()};
+    if (result.count("threads"))
+        threads = result["threads"].as<std::vector<int>>();
+    threads.erase(std::unique(threads.begin(), threads.end()), threads.end());
+
+    EngineOptions engineOptions;
+    engineOptions.mKernel     = result["kernel"].as<std::string>();
+    engineOptions.mAccumulate = result["accumulate"].as<bool>();
+    ASSERT(ParseCurveOrder(REORDER, engineOptions.mCurve), "Unknown reorder curve " + REORDER);
+    ASSERT(ParsePlacement(PLACEMENT, engineOptions.mPlacement), "Unknown placement " + PLACEMENT);
+    ASSERT(REPETITIONS > 0, "Need at least one repetition");
+
+    for (const auto& name : engines)
+        ASSERT(MakeEngine(name, engineOptions) != nullptr, "Unknown engine " + name + " or kernel " + engineOptions.mKernel);
+
+    std::map<std::string, double> baseline;
+    if (!BASELINE.empty())
+        ASSERT(ReadBaseline(BASELINE, baseline), "Error reading baseline " + BASELINE);
+
+    LOG_INFO("Kernel: %s, placement: %s, quadric scalar: %s, reorder: %s, %u warm-up + %u timed runs",
+             engineOptions.mKernel.c_str(), PLACEMENT.c_str(), QUADRIC_SCALAR_NAME, REORDER.c_str(),
+             WARMUP, REPETITIONS);
+
+    std::vector<BenchMesh> meshes;
+    std::vector<std::string> inputs, generated;
+    if (result.count("input"))
+        inputs = result["input"].as<std::vector<std::string>>();
+    if (result.count("generate"))
+        generated = result["generate"].as<std::vector<std::string>>();
+
+    for (const auto& spec : generated) {
+        GeneratorOptions generator;
+        ASSERT(ParseGeneratorSpec(spec, generator), "Unknown generated input " + spec);
+
+        BenchMesh mesh;
+        mesh.mName = std::string(MeshShapeName(generator.mShape)) + "_" + std::to_string(generator.mFaces)
+                   + "_s" + std::to_string(generator.mSeed);
+        GenerateMesh(generator, mesh.mPositions, mesh.mIndices);
+        LOG_INFO("%s generated: %zu faces", mesh.mName.c_str(), mesh.mIndices.size() / 3);
+        meshes.push_back(std::move(mesh));
+    }
+
+    for (const auto& path : inputs) {
+        BenchMesh mesh;
+        mesh.mName = std::filesystem::path(path).stem().string();
+
+        auto loader = MakeEngine(engines.front(), engineOptions);
+        ASSERT(loader->Load(path), "Error in mesh import of " + path);
+        loader->GetMesh(mesh.mPositions, mesh.mIndices);
+        LOG_INFO("%s successfully imported: %zu faces", path.c_str(), mesh.mIndices.size() / 3);
+        meshes.push_back(std::move(mesh));
+    }
+
+    std::vector<BenchResult> results;
+    for (const auto& mesh : meshes) {
+        for (const double ratio : RATIOS) {
+            for (const int nThreads : threads) {
+                omp_set_num_threads(nThreads);
+
+                for (const auto& name : engines) {
+                    BenchResult bench;
+                    bench.mMesh    = mesh.mName;
+                    bench.mEngine  = name;
+                    bench.mRatio   = FormatRatio(ratio);
+                    bench.mThreads = nThreads;
+                    bench.mFaces   = mesh.mIndices.size() / 3;
+                    bench.mTarget  = std::size_t(ratio * double(bench.mFaces));
+
+                    std::vector<double> init, run, total;
+                    for (uint32_t rep = 0; rep < WARMUP + REPETITIONS; ++rep) {
+                        auto engine = MakeEngine(name, engineOptions);
+                        engine->SetMesh(mesh.mPositions.data(), mesh.mPositions.size() / 3,
+                                        mesh.mIndices.data(), bench.mFaces);
+                        {
+                            PROFILING_SCOPE("Benchmark");
+                            engine->Init();
+                            engine->RunUntil(bench.mTarget);
+                        }
+                        // Every run is its own profiling tree, engines differ in shape
+                        ProfilingCleanup();
+
+                        if (rep < WARMUP) continue;
+
+                        const EngineStats stats = engine->Stats();
+                        init.push_back(stats.mInitMs);
+                        run.push_back(stats.mRunMs);
+                        total.push_back(stats.mInitMs + stats.mRunMs);
+                        bench.mFinalFaces = stats.mFaces;
+                        bench.mLoop = LoopStatsJson(stats);
+                    }
+
+                    bench.mInit  = Summarize(init);
+                    bench.mRun   = Summarize(run);
+                    bench.mTotal = Summarize(total);
+
+                    const auto key = BaselineKey(bench.mMesh, bench.mEngine, engineOptions.mKernel, PLACEMENT,
+                                                 QUADRIC_SCALAR_NAME, bench.mRatio, std::to_string(nThreads));
+                    if (baseline.count(key)) {
+                        bench.mBaselineMs = baseline[key];
+                        const double delta = bench.mTotal.mMedian / bench.mBaselineMs - 1.0;
+                        bench.mStatus = delta > REGRESSION ? "regression" : delta < -REGRESSION ? "improved" : "ok";
+                    }
+
+                    LOG_INFO("%s %-6s ratio %s threads %2d: %zu -> %zu faces, total median %.1f ms "
+                             "(p10 %.1f, p90 %.1f), init %.1f ms, loop %.1f ms%s%s",
+                             bench.mMesh.c_str(), bench.mEngine.c_str(), bench.mRatio.c_str(), nThreads,
+                             bench.mFaces, bench.mFinalFaces, bench.mTotal.mMedian, bench.mTotal.mP10,
+                             bench.mTotal.mP90, bench.mInit.mMedian, bench.mRun.mMedian,
+                             bench.mStatus == "new" ? "" : ", ", bench.mStatus == "new" ? "" : bench.mStatus.c_str());
+                    results.push_back(bench);
+                }
+            }
+        }
+    }
+
+    {
+        std::ofstream csv(CSV);
+        ASSERT(csv.good(), "Error opening " + CSV);
+        csv << "label,mesh,engine,kernel,placement,scalar,ratio,threads,faces,target,final_faces,repetitions,"
+               "init_median_ms,run_median_ms,total_min_ms,total_p10_ms,total_median_ms,total_p90_ms,total_max_ms,"
+               "total_mean_ms,baseline_ms,status\n";
+        for (const auto& r : results) {
+            csv << CsvString(LABEL) << ',' << CsvString(r.mMesh) << ',' << r.mEngine << ','
+                << CsvString(engineOptions.mKernel) << ',' << CsvString(PLACEMENT) << ',' << QUADRIC_SCALAR_NAME << ',' << r.mRatio << ',' << r.mThreads << ','
+                << r.mFaces << ',' << r.mTarget << ',' << r.mFinalFaces << ',' << r.mTotal.mCount << ','
+                << r.mInit.mMedian << ',' << r.mRun.mMedian << ',' << r.mTotal.mMin << ',' << r.mTotal.mP10 << ','
+                << r.mTotal.mMedian << ',' << r.mTotal.mP90 << ',' << r.mTotal.mMax << ',' << r.mTotal.mMean << ','
+                << r.mBaselineMs << ',' << r.mStatus << '\n';
+        }
+        LOG_INFO("Results written to %s", CSV.c_str());
+    }
+
+    if (!JSON.empty()) {
+        std::ofstream json(JSON);
+        ASSERT(json.good(), "Error opening " + JSON);
+
+        auto stats = [](const SampleStats& s) {
+            std::ostringstream oss;
+            oss << "{\"min\": " << s.mMin << ", \"p10\": " << s.mP10 << ", \"median\": " << s.mMedian
+                << ", \"p90\": " << s.mP90 << ", \"max\": " << s.mMax << ", \"mean\": " << s.mMean << "}";
+            return oss.str();
+        };
+
+        json << "{\n  \"label\": " << JsonString(LABEL) << ",\n  \"kernel\": " << JsonString(engineOptions.mKernel)
+             << ",\n  \"placement\": " << JsonString(PLACEMENT) << ",\n  \"scalar\": " << JsonString(QUADRIC_SCALAR_NAME)
+             << ",\n  \"warmup\": " << WARMUP << ",\n  \"repetitions\": " << REPETITIONS << ",\n  \"results\": [";
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            const auto& r = results[i];
+            json << (i ? "," : "") << "\n    {\"mesh\": " << JsonString(r.mMesh) << ", \"engine\": " << JsonString(r.mEngine)
+                 << ", \"ratio\": " << r.mRatio << ", \"threads\": " << r.mThreads << ", \"faces\": " << r.mFaces
+                 << ", \"target\": " << r.mTarget << ", \"final_faces\": " << r.mFinalFaces
+                 << ",\n     \"init_ms\": " << stats(r.mInit) << ",\n     \"run_ms\": " << stats(r.mRun)
+                 << ",\n     \"total_ms\": " << stats(r.mTotal) << ",\n     \"loop\": " << r.mLoop
+                 << ",\n     \"baseline_ms\": " << r.mBaselineMs << ", \"status\": " << JsonString(r.mStatus) << "}";
+        }
+        json << "\n  ]\n}\n";
+        LOG_INFO("Results written to %s", JSON.c_str());
+    }
+
+    // The last runs of every thread, older ones are dropped from the rings
+    ProfilingWriteTrace();
+
+    const auto regressions = std::count_if(results.begin(), results.end(),
+                                           [](const BenchResult& r) { return r.mStatus == "regression"; });
+    for (const auto& r : results) {
+        if (r.mStatus != "regression") continue;
+        LOG_WARN("Regression: %s %s ratio %s threads %d, %.1f ms against %.1f ms",
+                 r.mMesh.c_str(), r.mEngine.c_str(), r.mRatio.c_str(), r.mThreads,
+                 r.mTotal.mMedian, r.mBaselineMs);
+    }
+
+    return regressions > 0 ? 1 : 0;
+}
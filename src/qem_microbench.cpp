@@ -0,0 +1,370 @@
+#include "utils/profiling.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cxxopts.hpp>
+#include <fstream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include <utils/bench.h>
+#include <utils/flat_mesh.h>
+#include <utils/generate.h>
+#include <utils/mesh.h>
+#include <utils/mesh_io.h>
+#include <utils/perf_counters.h>
+#include <utils/simplify.h>
+#include <utils/utils.h>
+
+// Microbenchmarks of the mesh.h hot functions and of one collapse with its
+// 1-ring update, each timed alone on a working set of real mesh elements.
+// Hot runs repeat a small set of neighbouring elements after a warm-up
+// pass, cold runs take a random sample of the whole mesh after sweeping a
+// buffer larger than the last level cache. Every timed pass gives ns/op
+// and, when the PMU is reachable, hardware counters per op.
+
+enum class CacheState { Hot, Cold };
+
+inline const char* CacheStateName(const CacheState state) { return state == CacheState::Hot ? "hot" : "cold"; }
+
+struct MicroResult {
+    std::string mKernel;
+    CacheState  mState = CacheState::Hot;
+    std::size_t mOps   = 0;  // per timed pass
+    SampleStats mNsPerOp;
+    std::array<double, PERF_EVENT_COUNT> mPerOp{};  // median counts per op
+};
+
+struct MicroContext {
+    uint32_t          mRepetitions = 20;
+    std::vector<char> mFlushBuffer;
+    PerfCounters      mCounters;
+};
+
+// Evicts the caches by writing one byte per line of a large buffer
+static void FlushCaches(std::vector<char>& buffer)
+{
+    for (std::size_t i = 0; i < buffer.size(); i += 64) buffer[i] += 1;
+    DoNotOptimize(buffer.front());
+}
+
+// count ids of [0, n), the first ones for hot runs and a seeded shuffle of
+// the whole range for cold runs
+static std::vector<uint32_t> PickElements(const std::size_t n, const std::size_t count,
+                                          const CacheState state, const uint64_t seed)
+{
+    std::vector<uint32_t> ids(n);
+    std::iota(ids.begin(), ids.end(), 0);
+    if (state == CacheState::Cold) {
+        for (std::size_t i = n; i > 1; --i)
+            std::swap(ids[i - 1], ids[HashMix(seed ^ i) % i]);
+    }
+    ids.resize(std::min(count, n));
+    return ids;
+}
+
+// Collapsible edges with pairwise disjoint closed 1-rings, in the order of
+// PickElements, so every collapse of a pass stays valid whatever the
+// collapses before it did.
+template <typename MeshT>
+static std::vector<uint32_t> PickCollapses(MeshT& mesh, const std::size_t count,
+                                           const CacheState state, const uint64_t seed)
+{
+    std::vector<uint32_t> stamps(NumVertices(mesh), 0);
+    std::vector<uint32_t> edges;
+    for (auto e : PickElements(NumEdges(mesh), NumEdges(mesh), state, seed)) {
+        if (edges.size() == count) break;
+        if (CanCollapseEdge(mesh, e) && ClaimCollapseNeighborhood(mesh, e, stamps, 1))
+            edges.push_back(e);
+    }
+    return edges;
+}
+
+// prepare runs untimed before every pass (warm-up pass or mesh reset), cold
+// runs then flush the caches.
+template <typename Prepare, typename Body>
+static MicroResult Measure(MicroContext& ctx, const std::string& kernel, const CacheState state,
+                           const std::size_t ops, Prepare prepare, Body body)
+{
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<double> ns;
+    std::array<std::vector<double>, PERF_EVENT_COUNT> counts;
+    for (uint32_t rep = 0; rep < ctx.mRepetitions; ++rep) {
+        prepare();
+        if (state == CacheState::Cold) FlushCaches(ctx.mFlushBuffer);
+
+        ctx.mCounters.Start();
+        const auto start = Clock::now();
+        body();
+        const auto end = Clock::now();
+        ctx.mCounters.Stop();
+
+        ns.push_back(std::chrono::duration<double, std::nano>(end - start).count() / double(ops));
+        const PerfValues values = ctx.mCounters.Read();
+        for (std::size_t i = 0; i < PERF_EVENT_COUNT; ++i)
+            counts[i].push_back(double(values[i]) / double(ops));
+    }
+
+    MicroResult result;
+    result.mKernel  = kernel;
+    result.mState   = state;
+    result.mOps     = ops;
+    result.mNsPerOp = Summarize(ns);
+    for (std::size_t i = 0; i < PERF_EVENT_COUNT; ++i)
+        result.mPerOp[i] = Summarize(counts[i]).mMedian;
+    return result;
+}
+
+// Read-only kernels warm up with one untimed pass in the hot state
+template <typename Body>
+static MicroResult MeasureKernel(MicroContext& ctx, const std::string& kernel, const CacheState state,
+                                 const std::size_t ops, Body body)
+{
+    return Measure(ctx, kernel, state, ops, [&] { if (state == CacheState::Hot) body(); }, body);
+}
+
+// CanCollapseEdge, CollapseEdge, CollectDirtyEdges and the re-scoring of
+// the dirty edges, the loop body of CollapseBestEdge without the heap. The
+// mesh is restored before every pass.
+template <Placement P, typename MeshT>
+static MicroResult MeasureCollapse(MicroContext& ctx, const std::string& kernel, MeshT& pristine,
+                                   const CacheState state, const std::size_t count, const uint64_t seed,
+                                   const bool accumulate)
+{
+    const std::vector<uint32_t> edges = PickCollapses(pristine, count, state, seed);
+    ASSERT(!edges.empty(), "No collapsible edge in the mesh");
+
+    MeshT work;
+    std::vector<uint32_t> removed, dirty;
+    auto prepare = [&] {
+        work = pristine;
+        if (state == CacheState::Hot) {
+            bool ok = true;
+            for (auto e : edges) ok = CanCollapseEdge(work, e) && ok;
+            DoNotOptimize(ok);
+        }
+    };
+    auto body = [&] {
+        for (auto e : edges) {
+            if (!CanCollapseEdge(work, e)) continue;
+            removed.clear();
+            const uint32_t v = CollapseEdge(work, e, removed);
+            dirty.clear();
+            CollectDirtyEdges(work, v, accumulate, dirty);
+            UpdateEdgeErrors<P>(work, dirty);
+        }
+        DoNotOptimize(dirty.size());
+    };
+    return Measure(ctx, kernel, state, edges.size(), prepare, body);
+}
+
+template <Placement P>
+static void RunKernels(MicroContext& ctx, Mesh& mesh, FlatMesh& flat, const std::vector<CacheState>& states,
+                       const std::size_t workingSet, const uint64_t seed, const bool accumulate,
+                       std::vector<MicroResult>& results)
+{
+    for (const CacheState state : states) {
+        const auto faces = PickElements(NumFaces(mesh), workingSet, state, seed);
+        const auto vertices = PickElements(NumVertices(mesh), workingSet, state, seed);
+        const auto edges = PickElements(NumEdges(mesh), workingSet, state, seed);
+
+        results.push_back(MeasureKernel(ctx, "EvaluateFacePlane", state, faces.size(), [&] {
+            for (auto f : faces) {
+                const auto plane = EvaluateFacePlane(mesh, Mesh::FaceHandle(f));
+                DoNotOptimize(plane);
+            }
+        }));
+
+        results.push_back(MeasureKernel(ctx, "EvaluateFacePlaneMatrix", state, faces.size(), [&] {
+            for (auto f : faces) {
+                const auto Q = EvaluateFacePlaneMatrix(mesh, Mesh::FaceHandle(f));
+                DoNotOptimize(Q);
+            }
+        }));
+
+        results.push_back(MeasureKernel(ctx, "EvaluateVertexQuadratic", state, vertices.size(), [&] {
+            for (auto v : vertices) {
+                const auto Q = EvaluateVertexQuadratic(mesh, Mesh::VertexHandle(v));
+                DoNotOptimize(Q);
+            }
+        }));
+
+        // Includes the sum of the endpoint quadrics, as in UpdateEdgeError
+        results.push_back(MeasureKernel(ctx, std::string("EvaluateNewBestVertex<") + PlacementName(P) + ">",
+                                        state, edges.size(), [&] {
+            for (auto e : edges) {
+                const auto eh = Mesh::EdgeHandle(e);
+                const auto heh = mesh.halfedge_handle(eh, 0);
+                const SymQuadric Q = mesh.data(mesh.from_vertex_handle(heh)).Quadric
+                                   + mesh.data(mesh.to_vertex_handle(heh)).Quadric;
+                const auto p = EvaluateNewBestVertex<P>(mesh, eh, Q);
+                DoNotOptimize(p);
+            }
+        }));
+
+        results.push_back(MeasureCollapse<P>(ctx, "Collapse+1-ring (openmesh)", mesh, state,
+                                             workingSet, seed, accumulate));
+        results.push_back(MeasureCollapse<P>(ctx, "Collapse+1-ring (flat)", flat, state,
+                                             workingSet, seed, accumulate));
+    }
+}
+
+int main(int argc, char **argv) {
+    cxxopts::Options options("cli", "CLI app to microbenchmark the QEM kernels");
+    options.add_options()
+        ("i,input", "Input mesh filename, replaces the generated mesh", cxxopts::value<std::string>())
+        ("g,generate", "Generated mesh as shape:faces[:seed]",
+         cxxopts::value<std::string>()->default_value("icosphere:1000000"))
+        ("n,repetitions", "Timed passes per kernel", cxxopts::value<uint32_t>()->default_value("20"))
+        ("s,working-set", "Elements per pass", cxxopts::value<uint32_t>()->default_value("4096"))
+        ("c,cache", "Cache state: hot, cold or both", cxxopts::value<std::string>()->default_value("both"))
+        ("flush-mb", "Buffer swept before cold passes, above the LLC size",
+         cxxopts::value<uint32_t>()->default_value("64"))
+        ("seed", "Seed of the cold samples", cxxopts::value<uint64_t>()->default_value("1"))
+        ("p,placement", "Vertex placement of the collapses: optimal, endpoints or midpoint",
+         cxxopts::value<std::string>()->default_value("optimal"))
+        ("a,accumulate", "Keep accumulated quadrics and re-score only the edges of the surviving vertex",
+         cxxopts::value<bool>()->default_value("false"))
+        ("csv", "CSV results filename", cxxopts::value<std::string>()->default_value(""))
+        ("json", "JSON results filename", cxxopts::value<std::string>()->default_value(""));
+
+    auto result = options.parse(argc, argv);
+
+    if(result.count("help")) {
+        printf("%s", options.help().c_str());
+        return 0;
+    }
+
+    const std::string GENERATE        = result["generate"].as<std::string>();
+    const uint32_t    REPETITIONS     = result["repetitions"].as<uint32_t>();
+    const uint32_t    WORKING_SET     = result["working-set"].as<uint32_t>();
+    const std::string CACHE           = result["cache"].as<std::string>();
+    const uint32_t    FLUSH_MB        = result["flush-mb"].as<uint32_t>();
+    const uint64_t    SEED            = result["seed"].as<uint64_t>();
+    const std::string PLACEMENT       = result["placement"].as<std::string>();
+    const bool        ACCUMULATE      = result["accumulate"].as<bool>();
+    const std::string CSV             = result["csv"].as<std::string>();
+    const std::string JSON            = result["json"].as<std::string>();
+
+    Placement placement;
+    ASSERT(ParsePlacement(PLACEMENT, placement), "Unknown placement " + PLACEMENT);
+    ASSERT(CACHE == "hot" || CACHE == "cold" || CACHE == "both", "Unknown cache state " + CACHE);
+    ASSERT(REPETITIONS > 0 && WORKING_SET > 0, "Need at least one repetition and one element");
+
+    std::vector<CacheState> states;
+    if (CACHE != "cold") states.push_back(CacheState::Hot);
+    if (CACHE != "hot")  states.push_back(CacheState::Cold);
+
+    std::string meshName;
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    if (result.count("input")) {
+        meshName = result["input"].as<std::string>();
+        Mesh source;
+        ASSERT(ReadMesh(source, meshName), "Error in mesh import");
+        FlattenMesh(source, positions, indices);
+    } else {
+        GeneratorOptions generator;
+        ASSERT(ParseGeneratorSpec(GENERATE, generator), "Unknown generated mesh " + GENERATE);
+        meshName = GENERATE;
+        GenerateMesh(generator, positions, indices);
+    }
+
+    Mesh mesh;
+    FlatMesh flat;
+    BuildMeshFromArrays(mesh, positions.data(), positions.size() / 3, indices.data(), indices.size() / 3);
+    BuildMeshFromArrays(flat, positions.data(), positions.size() / 3, indices.data(), indices.size() / 3);
+    PrepareMesh(mesh);
+    PrepareMesh(flat);
+
+    MicroContext ctx;
+    ctx.mRepetitions = REPETITIONS;
+    ctx.mFlushBuffer.assign(std::size_t(FLUSH_MB) << 20, 0);
+
+    LOG_INFO("%s: %zu vertices, %zu faces, working set %u, %u passes, placement %s, quadric scalar %s",
+             meshName.c_str(), NumVertices(mesh), NumFaces(mesh), WORKING_SET, REPETITIONS,
+             PLACEMENT.c_str(), QUADRIC_SCALAR_NAME);
+    if (!ctx.mCounters.AnyAvailable())
+        LOG_WARN("Hardware counters unavailable (perf_event_open failed), reporting time only");
+
+    std::vector<MicroResult> results;
+    DispatchPlacement(placement, [&](auto policy) {
+        constexpr Placement P = decltype(policy)::value;
+
+        EdgeHeap pq;
+        pq.Resize(NumEdges(mesh));
+        InitQuadrics<P>(mesh, pq);
+        pq.Resize(NumEdges(flat));
+        InitQuadrics<P>(flat, pq);
+
+        RunKernels<P>(ctx, mesh, flat, states, WORKING_SET, SEED, ACCUMULATE, results);
+    });
+
+    auto perOp = [&](const MicroResult& r, const PerfEvent event) {
+        return ctx.mCounters.Available(event) ? r.mPerOp[std::size_t(event)] : -1.0;
+    };
+
+    for (const auto& r : results) {
+        const double cycles = perOp(r, PerfEvent::Cycles), instructions = perOp(r, PerfEvent::Instructions);
+        LOG_INFO("%-36s %-4s %6zu ops: %9.1f ns/op (p10 %.1f, p90 %.1f), %8.2f Mops/s"
+                 ", %.1f cycles/op, IPC %.2f, %.2f LLC, %.2f branch, %.2f dTLB misses/op",
+                 r.mKernel.c_str(), CacheStateName(r.mState), r.mOps, r.mNsPerOp.mMedian,
+                 r.mNsPerOp.mP10, r.mNsPerOp.mP90, 1e3 / r.mNsPerOp.mMedian,
+                 cycles, cycles > 0 && instructions >= 0 ? instructions / cycles : -1.0, perOp(r, PerfEvent::LlcMisses),
+                 perOp(r, PerfEvent::BranchMisses), perOp(r, PerfEvent::DtlbMisses));
+    }
+
+    // Counters that could not be opened are written as -1
+    if (!CSV.empty()) {
+        std::ofstream csv(CSV);
+        ASSERT(csv.good(), "Error opening " + CSV);
+        csv << "mesh,kernel,cache,placement,scalar,ops,ns_min,ns_p10,ns_median,ns_p90,ns_max,mops";
+        for (std::size_t i = 0; i < PERF_EVENT_COUNT; ++i)
+            csv << ',' << PerfEventName(static_cast<PerfEvent>(i)) << "_per_op";
+        csv << '\n';
+
+        for (const auto& r : results) {
+            csv << CsvString(meshName) << ',' << CsvString(r.mKernel) << ',' << CacheStateName(r.mState) << ',' << CsvString(PLACEMENT) << ','
+                << QUADRIC_SCALAR_NAME << ',' << r.mOps << ',' << r.mNsPerOp.mMin << ',' << r.mNsPerOp.mP10 << ','
+                << r.mNsPerOp.mMedian << ',' << r.mNsPerOp.mP90 << ',' << r.mNsPerOp.mMax << ','
+                << 1e3 / r.mNsPerOp.mMedian;
+            for (std::size_t i = 0; i < PERF_EVENT_COUNT; ++i)
+                csv << ',' << perOp(r, static_cast<PerfEvent>(i));
+            csv << '\n';
+        }
+        LOG_INFO("Results written to %s", CSV.c_str());
+    }
+
+    if (!JSON.empty()) {
+        std::ofstream json(JSON);
+        ASSERT(json.good(), "Error opening " + JSON);
+        json << "{\n  \"mesh\": " << JsonString(meshName) << ",\n  \"placement\": " << JsonString(PLACEMENT)
+             << ",\n  \"scalar\": " << JsonString(QUADRIC_SCALAR_NAME) << ",\n  \"repetitions\": " << REPETITIONS
+             << ",\n  \"results\": [";
+        for (std::size_t k = 0; k < results.size(); ++k) {
+            const auto& r = results[k];
+            json << (k ? "," : "") << "\n    {\"kernel\": " << JsonString(r.mKernel)
+                 << ", \"cache\": " << JsonString(CacheStateName(r.mState)) << ", \"ops\": " << r.mOps
+                 << ",\n     \"ns_per_op\": {\"min\": " << r.mNsPerOp.mMin << ", \"p10\": " << r.mNsPerOp.mP10
+                 << ", \"median\": " << r.mNsPerOp.mMedian << ", \"p90\": " << r.mNsPerOp.mP90
+                 << ", \"max\": " << r.mNsPerOp.mMax << "}, \"mops\": " << 1e3 / r.mNsPerOp.mMedian
+                 << ",\n     \"counters_per_op\": {";
+            bool first = true;
+            for (std::size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+                const auto event = static_cast<PerfEvent>(i);
+                if (!ctx.mCounters.Available(event)) continue;
+                json << (first ? "" : ", ") << JsonString(PerfEventName(event)) << ": " << r.mPerOp[i];
+                first = false;
+            }
+            json << "}}";
+        }
+        json << "\n  ]\n}\n";
+        LOG_INFO("Results written to %s", JSON.c_str());
+    }
+
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include "utils/profiling.h"
+#include <algorithm>
+#include <cstdint>
+#include <cxxopts.hpp>
+#include <iostream>
+#include <omp.h>
+#include <ostream>
+#include <unistd.h>
+#include <vector>
+
+#include <utils/utils.h>
+#include <utils/mesh.h>
+#include <utils/mesh_io.h>
+#include <utils/partition.h>
+#include <utils/simplify.h>
+
+
+int main(int argc, char **argv) {
+    ASSERT(argc > 1, "Need [input file]");
+
+    cxxopts::Options options("cli", "CLI app to test distributed mesh simplification");
+    options.add_options()
+        ("i,filename", "Input filename list", cxxopts::value<std::string>())
+        ("o,output", "Output filename (.obj, .ply, .bmesh or another OpenMesh format)",
+         cxxopts::value<std::string>()->default_value("out/out.obj"))
+        ("binary", "Write .ply outputs as binary PLY", cxxopts::value<bool>()->default_value("false"))
+        ("n,target", "Target faces", cxxopts::value<uint32_t>())
+        ("a,accumulate", "Keep accumulated quadrics and re-score only the edges of the surviving vertex",
+         cxxopts::value<bool>()->default_value("false"))
+        ("p,parts", "Number of partitions (default: OpenMP max threads)",
+         cxxopts::value<uint32_t>()->default_value("0"))
+        ("r,rings", "Rings around the partition borders unlocked in the seam pass",
+         cxxopts::value<int>()->default_value("2"));
+
+    options.parse_positional({"filename"});
+    auto result = options.parse(argc, argv);
+
+    if(result.count("help")) {
+        printf("%s", options.help().c_str());
+        return 0;
+    }
+
+    ASSERT(result.count("filename") >= 1, "Need [input filename]");
+    const std::string FILENAME        = result["filename"].as<std::string>();
+    const std::string OUTPUT          = result["output"].as<std::string>();
+    const bool        BINARY_PLY      = result["binary"].as<bool>();
+    const uint32_t    TARGET_FACES    = result["target"].as<uint32_t>();
+    const bool        ACCUMULATE      = result["accumulate"].as<bool>();
+    const int         SEAM_RINGS      = result["rings"].as<int>();
+    const uint32_t    PARTS           = result["parts"].as<uint32_t>() ?
+                                        result["parts"].as<uint32_t>() : omp_get_max_threads();
+
+    Mesh mesh;
+    ASSERT(ReadMesh(mesh, FILENAME), "Error in mesh import");
+    LOG_INFO("%s successfully imported", FILENAME.c_str());
+    LOG_INFO("Simplifying %u partitions, quadric update mode: %s",
+             PARTS, ACCUMULATE ? "accumulate" : "recompute");
+
+    const std::size_t totalFaces = mesh.n_faces();
+    {
+        PROFILING_SCOPE("CSG");
+
+        std::vector<MeshPiece> pieces;
+        {
+            PROFILING_SCOPE("Partitioning");
+            pieces = SplitMesh(mesh, PartitionFaces(mesh, PARTS), PARTS);
+            mesh.clear();
+        }
+
+        {
+            PROFILING_SCOPE("Local Simplification");
+
+            #pragma omp parallel for schedule(dynamic, 1)
+            for (int p = 0; p < PARTS; ++p) {
+                Mesh local;
+                local.request_vertex_status();
+                local.request_edge_status();
+                local.request_face_status();
+                local.request_halfedge_status();
+
+                OpenMesh::VPropHandleT<uint32_t> globalIds;
+                local.add_property(globalIds);
+                BuildMesh(local, pieces[p], globalIds);
+
+                const uint32_t target = static_cast<uint32_t>(
+                    double(TARGET_FACES) * pieces[p].NumFaces() / std::max<std::size_t>(totalFaces, 1)
+                );
+
+                EdgeHeap pq;
+                InitQuadrics<Placement::Optimal>(local, pq);
+                SimplifySequential<Placement::Optimal>(local, pq, target, ACCUMULATE);
+                local.garbage_collection();
+                pieces[p] = ExtractPiece(local, globalIds);
+            }
+        }
+
+        {
+            PROFILING_SCOPE("Seam Simplification");
+            mesh.request_vertex_status();
+            mesh.request_edge_status();
+            mesh.request_face_status();
+            mesh.request_halfedge_status();
+
+            auto seams = MergePieces(mesh, pieces);
+            pieces.clear();
+            LOG_INFO("%zu faces after the partition pass, %zu seam vertices", mesh.n_faces(), seams.size());
+            LockOutsideBand(mesh, seams, SEAM_RINGS);
+
+            EdgeHeap pq;
+            InitQuadrics<Placement::Optimal>(mesh, pq);
+            SimplifySequential<Placement::Optimal>(mesh, pq, TARGET_FACES, ACCUMULATE);
+        }
+
+        {
+            PROFILING_SCOPE("Mesh Cleanup");
+            mesh.garbage_collection();
+        }
+    }
+
+    LOG_DEBUG("Mesh vertices: %lu, edges: %lu, faces: %lu", mesh.n_vertices(), mesh.n_edges(), mesh.n_faces());
+    auto exported = WriteMeshAsync(mesh, OUTPUT, BINARY_PLY);
+    PROFILING_PRINT();
+    ASSERT(exported.get(), "Error in mesh export!");
+    LOG_INFO("Mesh successfully exported!");
+
+    return 0;
+
+}
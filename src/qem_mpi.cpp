@@ -0,0 +1,187 @@
+#include "utils/profiling.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cxxopts.hpp>
+#include <iostream>
+#include <mpi.h>
+#include <ostream>
+#include <unistd.h>
+#include <vector>
+
+#include <utils/utils.h>
+#include <utils/mesh.h>
+#include <utils/mesh_io.h>
+#include <utils/partition.h>
+#include <utils/simplify.h>
+
+constexpr int PIECE_SIZE_TAG = 0;
+constexpr int PIECE_DATA_TAG = 1;
+
+inline void SendBuffer(const std::vector<char>& buffer, const int dest)
+{
+    const uint64_t size = buffer.size();
+    MPI_Send(&size, 1, MPI_UINT64_T, dest, PIECE_SIZE_TAG, MPI_COMM_WORLD);
+
+    for (uint64_t offset = 0; offset < size; offset += INT_MAX) {
+        const int count = static_cast<int>(std::min<uint64_t>(INT_MAX, size - offset));
+        MPI_Send(buffer.data() + offset, count, MPI_BYTE, dest, PIECE_DATA_TAG, MPI_COMM_WORLD);
+    }
+}
+
+inline std::vector<char> RecvBuffer(const int source)
+{
+    uint64_t size = 0;
+    MPI_Recv(&size, 1, MPI_UINT64_T, source, PIECE_SIZE_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+    std::vector<char> buffer(size);
+    for (uint64_t offset = 0; offset < size; offset += INT_MAX) {
+        const int count = static_cast<int>(std::min<uint64_t>(INT_MAX, size - offset));
+        MPI_Recv(buffer.data() + offset, count, MPI_BYTE, source, PIECE_DATA_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    }
+    return buffer;
+}
+
+int main(int argc, char **argv) {
+    MPI_Init(&argc, &argv);
+
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    ASSERT(argc > 1, "Need [input file]");
+
+    cxxopts::Options options("cli", "CLI app to test distributed mesh simplification");
+    options.add_options()
+        ("i,filename", "Input filename list", cxxopts::value<std::string>())
+        ("o,output", "Output filename (.obj, .ply, .bmesh or another OpenMesh format)",
+         cxxopts::value<std::string>()->default_value("out/out.obj"))
+        ("binary", "Write .ply outputs as binary PLY", cxxopts::value<bool>()->default_value("false"))
+        ("n,target", "Target faces", cxxopts::value<uint32_t>())
+        ("a,accumulate", "Keep accumulated quadrics and re-score only the edges of the surviving vertex",
+         cxxopts::value<bool>()->default_value("false"))
+        ("r,rings", "Rings around the partition borders unlocked in the seam pass",
+         cxxopts::value<int>()->default_value("2"));
+
+    options.parse_positional({"filename"});
+    auto result = options.parse(argc, argv);
+
+    if(result.count("help")) {
+        if (rank == 0) printf("%s", options.help().c_str());
+        MPI_Finalize();
+        return 0;
+    }
+
+    ASSERT(result.count("filename") >= 1, "Need [input filename]");
+    const std::string FILENAME        = result["filename"].as<std::string>();
+    const std::string OUTPUT          = result["output"].as<std::string>();
+    const bool        BINARY_PLY      = result["binary"].as<bool>();
+    const uint32_t    TARGET_FACES    = result["target"].as<uint32_t>();
+    const bool        ACCUMULATE      = result["accumulate"].as<bool>();
+    const int         SEAM_RINGS      = result["rings"].as<int>();
+
+    Mesh mesh;
+    if (rank == 0) {
+        ASSERT(ReadMesh(mesh, FILENAME), "Error in mesh import");
+        LOG_INFO("%s successfully imported", FILENAME.c_str());
+        LOG_INFO("Simplifying on %d ranks, quadric update mode: %s",
+                 size, ACCUMULATE ? "accumulate" : "recompute");
+    }
+
+    MeshPiece piece;
+    uint64_t totalFaces = mesh.n_faces();
+    {
+        PROFILING_SCOPE("CSG");
+
+        {
+            PROFILING_SCOPE("Partitioning");
+            if (rank == 0) {
+                auto pieces = SplitMesh(mesh, PartitionFaces(mesh, size), size);
+                for (int r = 1; r < size; ++r) {
+                    SendBuffer(pieces[r].Serialize(), r);
+                    pieces[r] = MeshPiece();
+                }
+                piece = std::move(pieces[0]);
+                mesh.clear();
+            } else {
+                auto buffer = RecvBuffer(0);
+                piece = MeshPiece::Deserialize(buffer.data(), buffer.size());
+            }
+            MPI_Bcast(&totalFaces, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+        }
+
+        {
+            PROFILING_SCOPE("Local Simplification");
+            auto start = std::chrono::high_resolution_clock::now();
+
+            Mesh local;
+            local.request_vertex_status();
+            local.request_edge_status();
+            local.request_face_status();
+            local.request_halfedge_status();
+
+            OpenMesh::VPropHandleT<uint32_t> globalIds;
+            local.add_property(globalIds);
+            BuildMesh(local, piece, globalIds);
+
+            const uint32_t target = static_cast<uint32_t>(
+                double(TARGET_FACES) * piece.NumFaces() / std::max<uint64_t>(totalFaces, 1)
+            );
+
+            EdgeHeap pq;
+            InitQuadrics<Placement::Optimal>(local, pq);
+            SimplifySequential<Placement::Optimal>(local, pq, target, ACCUMULATE);
+            local.garbage_collection();
+            piece = ExtractPiece(local, globalIds);
+
+            auto end = std::chrono::high_resolution_clock::now();
+            LOG_INFO("[rank %d] %zu faces simplified in %.2f ms (target %u)",
+                     rank, piece.NumFaces(),
+                     std::chrono::duration<double, std::milli>(end - start).count(), target);
+        }
+
+        std::vector<MeshPiece> pieces;
+        {
+            PROFILING_SCOPE("Gather");
+            if (rank == 0) {
+                pieces.resize(size);
+                pieces[0] = std::move(piece);
+                for (int r = 1; r < size; ++r) {
+                    auto buffer = RecvBuffer(r);
+                    pieces[r] = MeshPiece::Deserialize(buffer.data(), buffer.size());
+                }
+            } else {
+                SendBuffer(piece.Serialize(), 0);
+            }
+        }
+
+        if (rank == 0) {
+            PROFILING_SCOPE("Seam Simplification");
+            mesh.request_vertex_status();
+            mesh.request_edge_status();
+            mesh.request_face_status();
+            mesh.request_halfedge_status();
+
+            auto seams = MergePieces(mesh, pieces);
+            pieces.clear();
+            LockOutsideBand(mesh, seams, SEAM_RINGS);
+
+            EdgeHeap pq;
+            InitQuadrics<Placement::Optimal>(mesh, pq);
+            SimplifySequential<Placement::Optimal>(mesh, pq, TARGET_FACES, ACCUMULATE);
+            mesh.garbage_collection();
+        }
+    }
+
+    if (rank == 0) {
+        LOG_DEBUG("Mesh vertices: %lu, edges: %lu, faces: %lu", mesh.n_vertices(), mesh.n_edges(), mesh.n_faces());
+        auto exported = WriteMeshAsync(mesh, OUTPUT, BINARY_PLY);
+        PROFILING_PRINT();
+        ASSERT(exported.get(), "Error in mesh export!");
+        LOG_INFO("Mesh successfully exported!");
+    }
+
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,350 @@
+#include "utils/profiling.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cxxopts.hpp>
+#include <fcntl.h>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <utils/utils.h>
+#include <utils/binary_mesh.h>
+#include <utils/mesh_writer.h>
+#include <utils/obj_stream.h>
+#include <utils/quadric.h>
+#include <utils/quadric_batch.h>
+
+// Out-of-core simplification by vertex clustering (Lindstrom, OoCS). The
+// input is streamed twice: the first pass spills the vertex positions to an
+// unlinked scratch file and computes the bounding box, the second one streams
+// the faces, adds every face plane quadric to the grid cells of its vertices
+// and keeps the triangles whose vertices fall in three different cells.
+// Memory is bounded by the number of occupied cells, which is derived from
+// the memory budget. Binary .bmesh inputs skip the scratch file, their
+// positions are used straight from the mapping.
+
+struct Cell {
+    SymQuadric      mQuadric;
+    Eigen::Vector3d mSum   = Eigen::Vector3d::Zero();
+    uint32_t        mCount = 0;
+    uint32_t        mIndex = 0;
+};
+
+struct CellTriangle {
+    std::array<uint32_t, 3> mCells;
+
+    bool operator==(const CellTriangle& other) const { return mCells == other.mCells; }
+};
+
+struct CellTriangleHash {
+    std::size_t operator()(const CellTriangle& t) const
+    {
+        uint64_t h = t.mCells[0];
+        h = h * 0x9E3779B97F4A7C15ull ^ t.mCells[1];
+        h = h * 0x9E3779B97F4A7C15ull ^ t.mCells[2];
+        return static_cast<std::size_t>(h ^ (h >> 29));
+    }
+};
+
+// Rough per-cell footprint: the cell, its map node and the ~2 output
+// triangles per cell with their set nodes.
+constexpr std::size_t BYTES_PER_CELL = sizeof(Cell) + 48 + 2 * (sizeof(CellTriangle) + 40);
+
+inline std::size_t PeakRSSBytes()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+}
+
+int main(int argc, char **argv) {
+    ASSERT(argc > 1, "Need [input file]");
+
+    cxxopts::Options options("cli", "CLI app to test distributed mesh simplification");
+    options.add_options()
+        ("i,filename", "Input filename (OBJ or .bmesh)", cxxopts::value<std::string>())
+        ("o,output", "Output filename (.obj, .ply or .bmesh)",
+         cxxopts::value<std::string>()->default_value("out/out.obj"))
+        ("binary", "Write .ply outputs as binary PLY", cxxopts::value<bool>()->default_value("false"))
+        ("n,target", "Approximate target faces (0: as many as the memory budget allows)",
+         cxxopts::value<uint32_t>()->default_value("0"))
+        ("m,memory", "Memory budget in MB", cxxopts::value<std::size_t>()->default_value("1024"))
+        ("g,grid", "Grid resolution along the longest axis (0: derived from target and budget)",
+         cxxopts::value<uint32_t>()->default_value("0"))
+        ("s,scratch", "Directory of the vertex scratch file", cxxopts::value<std::string>()->default_value("out"));
+
+    options.parse_positional({"filename"});
+    auto result = options.parse(argc, argv);
+
+    if(result.count("help")) {
+        printf("%s", options.help().c_str());
+        return 0;
+    }
+
+    ASSERT(result.count("filename") >= 1, "Need [input filename]");
+    const std::string FILENAME        = result["filename"].as<std::string>();
+    const std::string OUTPUT          = result["output"].as<std::string>();
+    const bool        BINARY_PLY      = result["binary"].as<bool>();
+    const uint32_t    TARGET_FACES    = result["target"].as<uint32_t>();
+    const std::size_t MEMORY_BUDGET   = result["memory"].as<std::size_t>() << 20;
+    const uint32_t    GRID            = result["grid"].as<uint32_t>();
+    const std::string SCRATCH_DIR     = result["scratch"].as<std::string>();
+    ASSERT(MeshFormatOf(OUTPUT) != MeshFormat::Other, "Unsupported output format " + OUTPUT);
+
+    // Half of the budget goes to the clustering, the rest covers the stream
+    // and spill buffers and the scratch file pages touched between two chunks.
+    const std::size_t maxCells = MEMORY_BUDGET / 2 / BYTES_PER_CELL;
+    const std::size_t chunkBytes = std::clamp<std::size_t>(MEMORY_BUDGET / 8, 1 << 20, 64 << 20);
+    ASSERT(maxCells > 0, "Memory budget too small");
+
+    std::vector<Cell> cells;
+    std::unordered_set<CellTriangle, CellTriangleHash> triangles;
+    {
+        PROFILING_SCOPE("CSG");
+
+        // Binary inputs are mapped directly, OBJ positions are spilled to an
+        // unlinked scratch file and mapped back.
+        const bool BINARY = IsBinaryMeshPath(FILENAME);
+        MappedBinaryMesh binary;
+        int scratch = -1;
+
+        uint64_t nVertices = 0, nFaces = 0;
+        Eigen::Vector3f lo = Eigen::Vector3f::Constant( std::numeric_limits<float>::max());
+        Eigen::Vector3f hi = Eigen::Vector3f::Constant(-std::numeric_limits<float>::max());
+        std::size_t mappedBytes = 0;
+        const float* positions = nullptr;
+
+        if (BINARY) {
+            PROFILING_SCOPE("Vertex Pass");
+            ASSERT(binary.Open(FILENAME), "Error in mesh import");
+            nVertices = binary.NumVertices();
+            nFaces    = binary.NumFaces();
+            positions = binary.Positions();
+
+            const std::size_t chunkVertices = chunkBytes / (3 * sizeof(float));
+            for (uint64_t v = 0; v < nVertices; ++v) {
+                const Eigen::Vector3f p = Eigen::Map<const Eigen::Vector3f>(positions + 3 * v);
+                lo = lo.cwiseMin(p);
+                hi = hi.cwiseMax(p);
+                if ((v + 1) % chunkVertices == 0) binary.Release();
+            }
+            binary.Release();
+            LOG_INFO("%s mapped: %lu vertices, %lu faces", FILENAME.c_str(), nVertices, nFaces);
+        } else {
+            std::string scratchPath = SCRATCH_DIR + "/.qem_ooc_XXXXXX";
+            scratch = mkstemp(scratchPath.data());
+            ASSERT(scratch >= 0, "Cannot create scratch file in " + SCRATCH_DIR);
+            unlink(scratchPath.c_str());
+
+            {
+                PROFILING_SCOPE("Vertex Pass");
+                const std::size_t pendingFloats = chunkBytes / sizeof(float) / 3 * 3;
+                std::vector<float> pending;
+                pending.reserve(pendingFloats);
+                auto flush = [&]() {
+                    const std::size_t bytes = pending.size() * sizeof(float);
+                    ASSERT(write(scratch, pending.data(), bytes) == ssize_t(bytes), "Scratch write failed");
+                    pending.clear();
+                };
+
+                bool ok = ObjStream(FILENAME, chunkBytes).Read(
+                    [&](float x, float y, float z) {
+                        if (pending.size() == pendingFloats) flush();
+                        pending.insert(pending.end(), {x, y, z});
+                        lo = lo.cwiseMin(Eigen::Vector3f(x, y, z));
+                        hi = hi.cwiseMax(Eigen::Vector3f(x, y, z));
+                        ++nVertices;
+                    },
+                    [&](uint32_t, uint32_t, uint32_t) { ++nFaces; },
+                    [&]() {}
+                );
+                ASSERT(ok, "Error in mesh import");
+                flush();
+                LOG_INFO("%s streamed: %lu vertices, %lu faces", FILENAME.c_str(), nVertices, nFaces);
+            }
+
+            mappedBytes = nVertices * 3 * sizeof(float);
+            if (mappedBytes) {
+                void* map = mmap(nullptr, mappedBytes, PROT_READ, MAP_SHARED, scratch, 0);
+                ASSERT(map != MAP_FAILED, "Cannot map the scratch file");
+                madvise(map, mappedBytes, MADV_RANDOM);
+                positions = static_cast<const float*>(map);
+            }
+        }
+
+        auto releasePositions = [&]() {
+            if (BINARY) binary.Release();
+            else if (positions) madvise(const_cast<float*>(positions), mappedBytes, MADV_DONTNEED);
+        };
+
+        const Eigen::Vector3f extent = (hi - lo).cwiseMax(1e-20f);
+        uint32_t resolution = GRID;
+        if (!resolution) {
+            // Occupied cells of a surface grow with the square of the
+            // resolution, the output has about two triangles per cell.
+            std::size_t cellsWanted = TARGET_FACES ? std::min<std::size_t>(TARGET_FACES / 2, maxCells) : maxCells;
+            resolution = std::max<uint32_t>(2, static_cast<uint32_t>(std::sqrt(cellsWanted / 4.0)));
+        }
+
+        std::unordered_map<uint64_t, uint32_t> cellIds;
+        bool overflow = true;
+        while (overflow) {
+            PROFILING_SCOPE("Clustering Pass");
+            overflow = false;
+            uint64_t invalidFaces = 0;
+            cells.clear();
+            cellIds.clear();
+            triangles.clear();
+
+            const float cellSize = extent.maxCoeff() / resolution;
+            auto cellOf = [&](uint32_t v) {
+                const float* p = positions + 3 * std::size_t(v);
+                uint64_t key = 0;
+                for (int k = 0; k < 3; ++k) {
+                    const uint64_t c = std::min<uint64_t>(resolution - 1,
+                        static_cast<uint64_t>((p[k] - lo[k]) / cellSize));
+                    key = key * resolution + c;
+                }
+                auto [it, inserted] = cellIds.try_emplace(key, static_cast<uint32_t>(cells.size()));
+                if (inserted) cells.emplace_back();
+                return it->second;
+            };
+
+            // Faces are buffered by blocks, the plane quadrics of a block go
+            // through the batched kernel and are then added to the cells.
+            FaceBlock block;
+            SymQuadric quadrics[QUADRIC_BLOCK];
+            uint32_t blockCells[QUADRIC_BLOCK][3];
+            uint32_t pending = 0;
+
+            auto flush = [&]() {
+                ComputeFaceQuadrics(block, pending, quadrics);
+                for (uint32_t i = 0; i < pending; ++i) {
+                    for (int k = 0; k < 3; ++k) {
+                        Cell& C = cells[blockCells[i][k]];
+                        C.mQuadric += quadrics[i];
+                        C.mSum += Eigen::Vector3d(block.mX[k][i], block.mY[k][i], block.mZ[k][i]);
+                        C.mCount += 1;
+                    }
+                }
+                pending = 0;
+            };
+
+            auto onFace = [&](uint32_t a, uint32_t b, uint32_t c) {
+                if (overflow) return;
+                if (a >= nVertices || b >= nVertices || c >= nVertices) {
+                    ++invalidFaces;
+                    return;
+                }
+
+                const uint32_t ids[3] = {a, b, c};
+                uint32_t* cell = blockCells[pending];
+                for (int k = 0; k < 3; ++k) {
+                    const float* p = positions + 3 * std::size_t(ids[k]);
+                    block.mX[k][pending] = p[0];
+                    block.mY[k][pending] = p[1];
+                    block.mZ[k][pending] = p[2];
+                    cell[k] = cellOf(ids[k]);
+                }
+
+                if (cell[0] != cell[1] && cell[1] != cell[2] && cell[0] != cell[2]) {
+                    // Rotate the smallest cell first, keeps the orientation
+                    const int first = cell[0] < cell[1] ? (cell[0] < cell[2] ? 0 : 2)
+                                                        : (cell[1] < cell[2] ? 1 : 2);
+                    triangles.insert({{cell[first], cell[(first + 1) % 3], cell[(first + 2) % 3]}});
+                }
+                overflow = cells.size() > maxCells || triangles.size() > 2 * maxCells;
+
+                if (++pending == QUADRIC_BLOCK) flush();
+            };
+
+            if (BINARY) {
+                const uint32_t* indices = binary.Indices();
+                const std::size_t chunkFaces = chunkBytes / (3 * sizeof(uint32_t));
+                for (uint64_t f = 0; f < nFaces && !overflow; ++f) {
+                    onFace(indices[3 * f], indices[3 * f + 1], indices[3 * f + 2]);
+                    if ((f + 1) % chunkFaces == 0) releasePositions();
+                }
+                releasePositions();
+            } else {
+                ObjStream(FILENAME, chunkBytes).Read([&](float, float, float) {}, onFace, releasePositions);
+            }
+            flush();
+            ASSERT(invalidFaces == 0, std::to_string(invalidFaces) + " faces with a vertex index out of range in " + FILENAME);
+
+            if (overflow) {
+                LOG_WARN("Grid %u exceeds the memory budget, retrying with a coarser grid", resolution);
+                ASSERT(resolution > 2, "Memory budget too small for the input");
+                resolution = std::max<uint32_t>(2, resolution * 7 / 10);
+            }
+        }
+        LOG_INFO("Grid %u: %zu occupied cells, %zu triangles", resolution, cells.size(), triangles.size());
+
+        if (BINARY) {
+            binary.Close();
+        } else {
+            if (positions) munmap(const_cast<float*>(positions), mappedBytes);
+            close(scratch);
+        }
+
+        {
+            PROFILING_SCOPE("Representatives");
+            const float cellSize = extent.maxCoeff() / resolution;
+            #pragma omp parallel for
+            for (int i = 0; i < cells.size(); ++i) {
+                Cell& C = cells[i];
+                const Eigen::Vector3d mean = C.mSum / std::max<uint32_t>(C.mCount, 1);
+
+                // The optimal point is kept only when it stays close to the
+                // cell, degenerate quadrics would throw it far away.
+                SymQuadric::Vector3 best;
+                if (!C.mQuadric.Solve(best) || (best.cast<double>() - mean).cwiseAbs().maxCoeff() > cellSize)
+                    C.mSum = mean;
+                else
+                    C.mSum = best.cast<double>();
+            }
+        }
+    }
+
+    std::future<bool> exported;
+    {
+        std::vector<float> positions;
+        std::vector<uint32_t> indices;
+        positions.reserve(3 * cells.size());
+        indices.reserve(3 * triangles.size());
+
+        uint32_t next = 0;
+        std::vector<uint8_t> used(cells.size(), 0);
+        for (const auto& t : triangles)
+            for (auto c : t.mCells) used[c] = 1;
+
+        for (std::size_t i = 0; i < cells.size(); ++i) {
+            if (!used[i]) continue;
+            cells[i].mIndex = next++;
+            positions.insert(positions.end(), {float(cells[i].mSum.x()), float(cells[i].mSum.y()), float(cells[i].mSum.z())});
+        }
+        for (const auto& t : triangles) {
+            for (auto c : t.mCells) indices.push_back(cells[c].mIndex);
+        }
+        exported = ExportMeshAsync(OUTPUT, std::move(positions), std::move(indices), MeshFormatOf(OUTPUT, BINARY_PLY));
+    }
+
+    PROFILING_PRINT();
+    ASSERT(exported.get(), "Error in mesh export!");
+    LOG_INFO("Mesh successfully exported!");
+    LOG_INFO("Peak RSS: %.1f MB (budget %zu MB)", PeakRSSBytes() / double(1 << 20), MEMORY_BUDGET >> 20);
+    return 0;
+
+}
@@ -0,0 +1,121 @@
+#include "utils/profiling.h"
+#include <cstdint>
+#include <cxxopts.hpp>
+#include <fstream>
+#include <iostream>
+#include <ostream>
+#include <string>
+#include <unistd.h>
+
+#include <qem/engine.h>
+#include <utils/utils.h>
+
+int main(int argc, char **argv) {
+    ASSERT(argc > 1, "Need [input file]");
+
+    cxxopts::Options options("cli", "CLI app to test distributed mesh simplification");
+    options.add_options()
+        ("i,filename", "Input filename list", cxxopts::value<std::string>())
+        ("o,output", "Output filename (.obj, .ply, .bmesh or another OpenMesh format)",
+         cxxopts::value<std::string>()->default_value("out/out.obj"))
+        ("binary", "Write .ply outputs as binary PLY", cxxopts::value<bool>()->default_value("false"))
+        ("n,target", "Target faces", cxxopts::value<uint32_t>())
+        ("e,engine", "Simplification engine: seq, mp_v1, mp_v2 or mp_v3",
+         cxxopts::value<std::string>()->default_value("seq"))
+        ("a,accumulate", "Keep accumulated quadrics and re-score only the edges of the surviving vertex",
+         cxxopts::value<bool>()->default_value("false"))
+        ("b,batch", "Max collapses per round (mp_v3)", cxxopts::value<uint32_t>()->default_value("4096"))
+        ("t,tolerance", "Max relative error over the round best edge accepted in a batch (mp_v3)",
+         cxxopts::value<double>()->default_value("0.5"))
+        ("k,kernel", "Mesh kernel: openmesh or flat", cxxopts::value<std::string>()->default_value("openmesh"))
+        ("r,reorder", "Reorder vertices and faces along a space-filling curve: none, morton or hilbert",
+         cxxopts::value<std::string>()->default_value("none"))
+        ("p,placement", "Vertex placement of the collapses: optimal, endpoints or midpoint",
+         cxxopts::value<std::string>()->default_value("optimal"))
+        ("trace", "Chrome trace-event JSON of the profiling scopes (default: $QEM_TRACE)",
+         cxxopts::value<std::string>()->default_value(""))
+        ("counters", "Hardware counters in the profiling scopes (default: $QEM_COUNTERS)",
+         cxxopts::value<bool>()->default_value("false"))
+        ("profile-json", "JSON of the profiling tree (default: $QEM_PROFILE_JSON)",
+         cxxopts::value<std::string>()->default_value(""))
+        ("stats-json", "JSON of the collapse loop statistics", cxxopts::value<std::string>()->default_value(""));
+
+    options.parse_positional({"filename"});
+    auto result = options.parse(argc, argv);
+
+    if(result.count("help")) {
+        printf("%s", options.help().c_str());
+        return 0;
+    }
+
+    ASSERT(result.count("filename") >= 1, "Need [input filename]");
+    const std::string FILENAME        = result["filename"].as<std::string>();
+    const std::string OUTPUT          = result["output"].as<std::string>();
+    const bool        BINARY_PLY      = result["binary"].as<bool>();
+    const uint32_t    TARGET_FACES    = result["target"].as<uint32_t>();
+    const std::string ENGINE          = result["engine"].as<std::string>();
+    const std::string REORDER         = result["reorder"].as<std::string>();
+    const std::string PLACEMENT       = result["placement"].as<std::string>();
+    const std::string TRACE           = result["trace"].as<std::string>();
+    const std::string PROFILE_JSON    = result["profile-json"].as<std::string>();
+    const std::string STATS_JSON      = result["stats-json"].as<std::string>();
+
+    if (!TRACE.empty()) ProfilingTraceTo(TRACE);
+    if (!PROFILE_JSON.empty()) ProfilingJsonTo(PROFILE_JSON);
+    if (result["counters"].as<bool>()) ProfilingCountersOn(true);
+
+    EngineOptions engineOptions;
+    engineOptions.mKernel     = result["kernel"].as<std::string>();
+    engineOptions.mAccumulate = result["accumulate"].as<bool>();
+    engineOptions.mBatchSize  = result["batch"].as<uint32_t>();
+    engineOptions.mTolerance  = result["tolerance"].as<double>();
+    ASSERT(engineOptions.mBatchSize > 0, "Batch size must be at least 1");
+    ASSERT(ParseCurveOrder(REORDER, engineOptions.mCurve), "Unknown reorder curve " + REORDER);
+    ASSERT(ParsePlacement(PLACEMENT, engineOptions.mPlacement), "Unknown placement " + PLACEMENT);
+
+    auto engine = MakeEngine(ENGINE, engineOptions);
+    ASSERT(engine != nullptr, "Unknown engine " + ENGINE + " or kernel " + engineOptions.mKernel);
+
+    LOG_INFO("Engine: %s, quadric update mode: %s, kernel: %s, reorder: %s",
+             engine->Name(), engineOptions.mAccumulate ? "accumulate" : "recompute",
+             engineOptions.mKernel.c_str(), REORDER.c_str());
+    LOG_INFO("Placement: %s, quadric scalar: %s", PLACEMENT.c_str(), QUADRIC_SCALAR_NAME);
+    if (ENGINE == "mp_v3")
+        LOG_INFO("Batch size: %u, tolerance: %g", engineOptions.mBatchSize, engineOptions.mTolerance);
+
+    ASSERT(engine->Load(FILENAME), "Error in mesh import");
+    LOG_INFO("%s successfully imported", FILENAME.c_str());
+
+    {
+        PROFILING_SCOPE("CSG");
+        engine->Init();
+
+        {
+            PROFILING_SCOPE("Processing");
+            engine->RunUntil(TARGET_FACES);
+            {
+                PROFILING_SCOPE("Mesh Cleanup");
+                engine->Compact();
+            }
+        }
+    }
+
+    const EngineStats stats = engine->Stats();
+    LOG_INFO("%zu -> %zu faces, %lu collapses in %lu steps (init %.1f ms, loop %.1f ms)",
+             stats.mInitialFaces, stats.mFaces, stats.mCollapses, stats.mSteps, stats.mInitMs, stats.mRunMs);
+
+    auto exported = engine->Save(OUTPUT, BINARY_PLY);
+
+    PROFILING_PRINT();
+    std::cout << LoopStatsReport(stats);
+    if (!STATS_JSON.empty()) {
+        std::ofstream json(STATS_JSON);
+        ASSERT(json.good(), "Error opening " + STATS_JSON);
+        json << LoopStatsJson(stats) << "\n";
+    }
+    ASSERT(exported.get(), "Error in mesh export!");
+    LOG_INFO("Mesh successfully exported!");
+
+    return 0;
+
+}
@@ -0,0 +1,90 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Summary of the repetitions of one benchmark configuration
+struct SampleStats {
+    std::size_t mCount  = 0;
+    double      mMin    = 0.0;
+    double      mP10    = 0.0;
+    double      mMedian = 0.0;
+    double      mP90    = 0.0;
+    double      mMax    = 0.0;
+    double      mMean   = 0.0;
+};
+
+// Percentile p in [0, 1] of sorted samples, linear between closest ranks
+inline double Percentile(const std::vector<double>& sorted, const double p)
+{
+    if (sorted.empty()) return 0.0;
+
+    const double rank = p * double(sorted.size() - 1);
+    const std::size_t lo = std::size_t(rank);
+    const std::size_t hi = std::min(lo + 1, sorted.size() - 1);
+    return sorted[lo] + (rank - double(lo)) * (sorted[hi] - sorted[lo]);
+}
+
+inline SampleStats Summarize(std::vector<double> samples)
+{
+    SampleStats stats;
+    if (samples.empty()) return stats;
+
+    std::sort(samples.begin(), samples.end());
+    stats.mCount  = samples.size();
+    stats.mMin    = samples.front();
+    stats.mP10    = Percentile(samples, 0.1);
+    stats.mMedian = Percentile(samples, 0.5);
+    stats.mP90    = Percentile(samples, 0.9);
+    stats.mMax    = samples.back();
+
+    for (auto s : samples) stats.mMean += s;
+    stats.mMean /= double(samples.size());
+    return stats;
+}
+
+// Keeps value (and the work producing it) alive through the optimizer
+template <typename T>
+inline void DoNotOptimize(const T& value)
+{
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+// String as a JSON literal, quotes included
+inline std::string JsonString(const std::string& s)
+{
+    std::string out = "\"";
+    for (const char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+// CSV field, quoted (with doubled quotes) when it holds a comma, a quote or
+// a line break
+inline std::string CsvString(const std::string& s)
+{
+    if (s.find_first_of(",\"\r\n") == std::string::npos) return s;
+
+    std::string out = "\"";
+    for (const char c : s) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    return out + "\"";
+}
+
+#endif // !BENCH_H
@@ -0,0 +1,246 @@
+#ifndef BINARY_MESH_H
+#define BINARY_MESH_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "massert.h"
+
+// Binary triangle mesh (.bmesh), laid out so it can be used straight from an
+// mmap without parsing:
+//
+//      BinaryMeshHeader                    32 bytes
+//      float    positions[3 * nVertices]
+//      uint32_t indices  [3 * nFaces]
+//      uint32_t opposites[3 * nFaces]      only with BINARY_MESH_ADJACENCY
+//
+// Corner c is the c % 3 vertex of face c / 3, opposites[c] is the corner
+// facing c across the edge opposite to it, or BINARY_MESH_NO_CORNER on
+// boundaries and non-manifold edges.
+
+constexpr char     BINARY_MESH_MAGIC[4]  = {'B', 'M', 'S', 'H'};
+constexpr uint32_t BINARY_MESH_VERSION   = 1;
+constexpr uint32_t BINARY_MESH_ADJACENCY = 1u << 0;
+constexpr uint32_t BINARY_MESH_NO_CORNER = 0xFFFFFFFFu;
+
+struct BinaryMeshHeader {
+    char     mMagic[4];
+    uint32_t mVersion;
+    uint64_t mVertices;
+    uint64_t mFaces;
+    uint32_t mFlags;
+    uint32_t mReserved;
+};
+static_assert(sizeof(BinaryMeshHeader) == 32, "Binary mesh header must be 32 bytes");
+
+inline bool IsBinaryMeshPath(const std::string& path)
+{
+    const std::string ext = ".bmesh";
+    return path.size() >= ext.size() && path.compare(path.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+// Read-only view over a mapped .bmesh file, the arrays point into the mapping
+class MappedBinaryMesh {
+    void*       mData = nullptr;
+    std::size_t mSize = 0;
+
+public:
+    MappedBinaryMesh() = default;
+    MappedBinaryMesh(const MappedBinaryMesh&) = delete;
+    MappedBinaryMesh& operator=(const MappedBinaryMesh&) = delete;
+
+    MappedBinaryMesh(MappedBinaryMesh&& other) noexcept
+        : mData(std::exchange(other.mData, nullptr)), mSize(std::exchange(other.mSize, 0))
+    {}
+
+    ~MappedBinaryMesh() { Close(); }
+
+    inline bool Open(const std::string& path)
+    {
+        Close();
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < off_t(sizeof(BinaryMeshHeader))) {
+            close(fd);
+            return false;
+        }
+
+        void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) return false;
+
+        mData = data;
+        mSize = st.st_size;
+
+        // Counts are bounded by the payload before multiplying, a corrupt
+        // header must not wrap the expected size around
+        const auto& header = Header();
+        const uint64_t payload = mSize - sizeof(BinaryMeshHeader);
+        const uint64_t maxRecords = payload / (3 * sizeof(float));
+        const bool countsOk = header.mVertices <= maxRecords && header.mFaces <= maxRecords;
+        const uint64_t expected = countsOk ? sizeof(BinaryMeshHeader) +
+            header.mVertices * 3 * sizeof(float) +
+            header.mFaces * 3 * sizeof(uint32_t) * (header.mFlags & BINARY_MESH_ADJACENCY ? 2 : 1) : 0;
+
+        if (std::memcmp(header.mMagic, BINARY_MESH_MAGIC, 4) != 0 ||
+            header.mVersion != BINARY_MESH_VERSION || (header.mFlags & ~BINARY_MESH_ADJACENCY) != 0 ||
+            !countsOk || mSize < expected) {
+            Close();
+            return false;
+        }
+
+        madvise(mData, mSize, MADV_SEQUENTIAL);
+        return true;
+    }
+
+    inline void Close()
+    {
+        if (mData) munmap(mData, mSize);
+        mData = nullptr;
+        mSize = 0;
+    }
+
+    inline bool IsOpen() const { return mData != nullptr; }
+
+    // Drops the resident pages, they are read back from the file on access
+    inline void Release() const
+    {
+        if (mData) madvise(mData, mSize, MADV_DONTNEED);
+    }
+
+    inline const BinaryMeshHeader& Header() const
+    {
+        return *static_cast<const BinaryMeshHeader*>(mData);
+    }
+
+    inline std::size_t NumVertices() const { return Header().mVertices; }
+    inline std::size_t NumFaces()    const { return Header().mFaces; }
+    inline bool HasAdjacency()       const { return Header().mFlags & BINARY_MESH_ADJACENCY; }
+
+    inline const float* Positions() const
+    {
+        return reinterpret_cast<const float*>(static_cast<const char*>(mData) + sizeof(BinaryMeshHeader));
+    }
+
+    inline const uint32_t* Indices() const
+    {
+        return reinterpret_cast<const uint32_t*>(Positions() + 3 * NumVertices());
+    }
+
+    inline const uint32_t* Opposites() const
+    {
+        return HasAdjacency() ? Indices() + 3 * NumFaces() : nullptr;
+    }
+};
+
+// Opposite corner table of an indexed triangle list. Corners are bucketed by
+// their smaller edge endpoint and every bucket is sorted by the larger one,
+// so the corners of an edge end up next to each other whatever the valence.
+// Faces with an index past nVertices are left unmatched.
+inline std::vector<uint32_t> ComputeOppositeCorners(const uint32_t* indices,
+                                                    const std::size_t nFaces,
+                                                    const std::size_t nVertices)
+{
+    const std::size_t nCorners = 3 * nFaces;
+    std::vector<uint32_t> opposites(nCorners, BINARY_MESH_NO_CORNER);
+    std::vector<uint32_t> offsets(nVertices + 1, 0);
+
+    // Corner c faces the edge (next(c), prev(c))
+    auto edgeOf = [&](std::size_t c) {
+        const std::size_t f = c / 3;
+        const uint32_t a = indices[3 * f + (c + 1) % 3];
+        const uint32_t b = indices[3 * f + (c + 2) % 3];
+        return std::make_pair(a, b);
+    };
+    auto inRange = [&](std::size_t c) {
+        const uint32_t* v = indices + 3 * (c / 3);
+        return v[0] < nVertices && v[1] < nVertices && v[2] < nVertices;
+    };
+    auto maxEndpoint = [&](std::size_t c) {
+        auto [a, b] = edgeOf(c);
+        return std::max(a, b);
+    };
+
+    for (std::size_t c = 0; c < nCorners; ++c) {
+        if (!inRange(c)) continue;
+        auto [a, b] = edgeOf(c);
+        ++offsets[std::min(a, b) + 1];
+    }
+    for (std::size_t v = 0; v < nVertices; ++v)
+        offsets[v + 1] += offsets[v];
+
+    std::vector<uint32_t> buckets(offsets[nVertices]);
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (std::size_t c = 0; c < nCorners; ++c) {
+        if (!inRange(c)) continue;
+        auto [a, b] = edgeOf(c);
+        buckets[fill[std::min(a, b)]++] = static_cast<uint32_t>(c);
+    }
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (std::size_t v = 0; v < nVertices; ++v) {
+        uint32_t* first = buckets.data() + offsets[v];
+        uint32_t* last  = buckets.data() + offsets[v + 1];
+        std::sort(first, last, [&](uint32_t c, uint32_t d) {
+            const uint32_t mc = maxEndpoint(c), md = maxEndpoint(d);
+            return mc != md ? mc < md : c < d;
+        });
+
+        // A manifold edge has exactly two corners, with reversed endpoints
+        for (uint32_t* it = first; it < last;) {
+            uint32_t* end = it + 1;
+            while (end < last && maxEndpoint(*end) == maxEndpoint(*it)) ++end;
+            if (end - it == 2) {
+                auto [a, b] = edgeOf(it[0]);
+                auto [x, y] = edgeOf(it[1]);
+                if (x == b && y == a) {
+                    opposites[it[0]] = it[1];
+                    opposites[it[1]] = it[0];
+                }
+            }
+            it = end;
+        }
+    }
+
+    return opposites;
+}
+
+inline bool WriteBinaryMesh(const std::string& path,
+                            const float* positions, const std::size_t nVertices,
+                            const uint32_t* indices, const std::size_t nFaces,
+                            const bool adjacency = false)
+{
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+
+    BinaryMeshHeader header{};
+    std::memcpy(header.mMagic, BINARY_MESH_MAGIC, 4);
+    header.mVersion  = BINARY_MESH_VERSION;
+    header.mVertices = nVertices;
+    header.mFaces    = nFaces;
+    header.mFlags    = adjacency ? BINARY_MESH_ADJACENCY : 0;
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && std::fwrite(positions, sizeof(float), 3 * nVertices, file) == 3 * nVertices;
+    ok = ok && std::fwrite(indices, sizeof(uint32_t), 3 * nFaces, file) == 3 * nFaces;
+
+    if (ok && adjacency) {
+        auto opposites = ComputeOppositeCorners(indices, nFaces, nVertices);
+        ok = std::fwrite(opposites.data(), sizeof(uint32_t), opposites.size(), file) == opposites.size();
+    }
+
+    return std::fclose(file) == 0 && ok;
+}
+
+#endif // !BINARY_MESH_H
@@ -0,0 +1,44 @@
+#ifndef CURVE_ORDER_H
+#define CURVE_ORDER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// Space-filling curve of the reorder stage and its estimated effect, apart
+// from reorder.h so that the engine API does not pull in the mesh kernels.
+
+enum class CurveOrder { None, Morton, Hilbert };
+
+inline bool ParseCurveOrder(const std::string& name, CurveOrder& curve)
+{
+    if (name == "none")    { curve = CurveOrder::None;    return true; }
+    if (name == "morton")  { curve = CurveOrder::Morton;  return true; }
+    if (name == "hilbert") { curve = CurveOrder::Hilbert; return true; }
+    return false;
+}
+
+inline const char* CurveOrderName(const CurveOrder curve)
+{
+    switch (curve) {
+        case CurveOrder::Morton:  return "morton";
+        case CurveOrder::Hilbert: return "hilbert";
+        default:                  return "none";
+    }
+}
+
+struct ReorderStats {
+    uint64_t mMissesBefore = 0;
+    uint64_t mMissesAfter  = 0;
+
+    inline std::string Summary() const
+    {
+        const double reduction = mMissesBefore ? 100.0 * (1.0 - double(mMissesAfter) / mMissesBefore) : 0.0;
+        char buffer[128];
+        std::snprintf(buffer, sizeof(buffer), "Estimated cache misses %lu -> %lu (%.1f%% less)",
+                      mMissesBefore, mMissesAfter, reduction);
+        return buffer;
+    }
+};
+
+#endif // !CURVE_ORDER_H
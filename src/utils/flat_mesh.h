@@ -0,0 +1,577 @@
+#ifndef FLAT_MESH_H
+#define FLAT_MESH_H
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "binary_mesh.h"
+#include "mesh.h"
+#include "quadric.h"
+#include "quadric_batch.h"
+
+// Corner table kernel specialized for edge collapse. Corner c is the c % 3
+// vertex of face c / 3 and mOpposite[c] the corner facing it across the edge
+// opposite to c. Every array is indexed directly, deleted elements are
+// marked in place and only removed by Compact().
+//
+// Edge e is stored in mEdgeCorner[e], one of its corners c: the edge runs
+// from V[Next(c)] to V[Prev(c)] and collapsing it moves the former into the
+// latter, like the first halfedge of an OpenMesh edge. BuildMeshConnectivity
+// numbers edges the same way, so both kernels see the same edge ids.
+struct FlatMesh {
+    enum : uint8_t { VertexDeleted = 1 << 0, VertexLocked = 1 << 1 };
+
+    // Vertices, SoA positions
+    std::vector<float>      mX, mY, mZ;
+    std::vector<SymQuadric> mVertexQuadric;
+    std::vector<uint32_t>   mVertexCorner;
+    std::vector<uint8_t>    mVertexFlags;
+
+    // Corners, a face is deleted when its first corner has no vertex
+    std::vector<uint32_t>   mCornerVertex;
+    std::vector<uint32_t>   mOpposite;
+    std::vector<uint32_t>   mCornerEdge;
+
+    std::vector<SymQuadric> mFaceQuadric;
+
+    // Edges, an edge is deleted when it has no corner
+    std::vector<uint32_t>        mEdgeCorner;
+    std::vector<QuadricScalar>   mEdgeError;
+    std::vector<Eigen::Vector3f> mEdgeNewVertex;
+
+    static inline uint32_t Next(const uint32_t c) { return c % 3 == 2 ? c - 2 : c + 1; }
+    static inline uint32_t Prev(const uint32_t c) { return c % 3 == 0 ? c + 2 : c - 1; }
+
+    inline std::size_t NumVertices() const { return mX.size(); }
+    inline std::size_t NumFaces()    const { return mFaceQuadric.size(); }
+    inline std::size_t NumEdges()    const { return mEdgeCorner.size(); }
+
+    inline Eigen::Vector3f Point(const uint32_t v) const { return {mX[v], mY[v], mZ[v]}; }
+
+    inline void SetPoint(const uint32_t v, const Eigen::Vector3f& p)
+    {
+        mX[v] = p.x();
+        mY[v] = p.y();
+        mZ[v] = p.z();
+    }
+
+    inline bool IsVertexDeleted(const uint32_t v) const { return mVertexFlags[v] & VertexDeleted; }
+    inline bool IsVertexLocked(const uint32_t v)  const { return mVertexFlags[v] & VertexLocked; }
+    inline bool IsFaceDeleted(const uint32_t f)   const { return mCornerVertex[3 * f] == InvalidIndex; }
+    inline bool IsEdgeDeleted(const uint32_t e)   const { return mEdgeCorner[e] == InvalidIndex; }
+
+    inline std::array<uint32_t, 2> EdgeVertices(const uint32_t e) const
+    {
+        const uint32_t c = mEdgeCorner[e];
+        return {mCornerVertex[Next(c)], mCornerVertex[Prev(c)]};
+    }
+
+    inline bool IsBoundaryEdge(const uint32_t e) const { return mOpposite[mEdgeCorner[e]] == InvalidIndex; }
+
+    // Visits the corners of the fan of start, returns true if the fan is open
+    // (the vertex is on the boundary).
+    template <typename Fn>
+    inline bool ForEachFanCorner(const uint32_t start, Fn fn) const
+    {
+        uint32_t c = start;
+        while (true) {
+            fn(c);
+            const uint32_t o = mOpposite[Prev(c)];
+            if (o == InvalidIndex) break;
+            c = Prev(o);
+            if (c == start) return false;
+        }
+
+        // Open fan, the other side of start is walked the opposite way
+        c = start;
+        while (true) {
+            const uint32_t o = mOpposite[Next(c)];
+            if (o == InvalidIndex) break;
+            c = Next(o);
+            fn(c);
+        }
+        return true;
+    }
+
+    template <typename Fn>
+    inline bool ForEachVertexCorner(const uint32_t v, Fn fn) const
+    {
+        if (mVertexCorner[v] == InvalidIndex) return false;
+        return ForEachFanCorner(mVertexCorner[v], fn);
+    }
+
+    // Neighbors of v: the next vertex of every fan corner, plus the previous
+    // vertex of the corner closing an open fan.
+    template <typename Fn>
+    inline bool ForEachVertexVertex(const uint32_t v, Fn fn) const
+    {
+        uint32_t last = InvalidIndex;
+        const bool open = ForEachVertexCorner(v, [&](uint32_t c) {
+            fn(mCornerVertex[Next(c)]);
+            if (mOpposite[Next(c)] == InvalidIndex) last = mCornerVertex[Prev(c)];
+        });
+        if (open) fn(last);
+        return open;
+    }
+
+    // Link condition and the degenerate cases OpenMesh's is_collapse_ok
+    // rejects, computed on the corner table without circulators.
+    inline bool IsCollapseOk(const uint32_t e) const
+    {
+        const uint32_t c = mEdgeCorner[e];
+        if (c == InvalidIndex) return false;
+
+        const uint32_t o  = mOpposite[c];
+        const uint32_t v0 = mCornerVertex[Next(c)];
+        const uint32_t v1 = mCornerVertex[Prev(c)];
+        const uint32_t vl = mCornerVertex[c];
+        const uint32_t vr = o != InvalidIndex ? mCornerVertex[o] : InvalidIndex;
+        if (IsVertexDeleted(v0) || IsVertexDeleted(v1) || vl == vr) return false;
+
+        // A face whose two other edges are on the boundary would degenerate
+        if (mOpposite[Next(c)] == InvalidIndex && mOpposite[Prev(c)] == InvalidIndex) return false;
+        if (o != InvalidIndex && mOpposite[Next(o)] == InvalidIndex && mOpposite[Prev(o)] == InvalidIndex)
+            return false;
+
+        thread_local std::vector<uint32_t> ring0, ring1;
+        ring0.clear();
+        ring1.clear();
+        const bool boundary0 = ForEachVertexVertex(v0, [&](uint32_t w) { ring0.push_back(w); });
+        const bool boundary1 = ForEachVertexVertex(v1, [&](uint32_t w) { ring1.push_back(w); });
+
+        // An interior edge between two boundary vertices would pinch the mesh
+        if (o != InvalidIndex && boundary0 && boundary1) return false;
+
+        // Collapsing an interior edge of a tetrahedron leaves a double face
+        if (o != InvalidIndex && ring0.size() == 3 && ring1.size() == 3) return false;
+
+        for (auto w : ring1) {
+            if (w == v0 || w == vl || w == vr) continue;
+            for (auto u : ring0)
+                if (u == w) return false;
+        }
+        return true;
+    }
+
+    // Collapses e from its first vertex into its second one, the caller sets
+    // the position. Deleted edges are appended to removed.
+    inline void Collapse(const uint32_t e, std::vector<uint32_t>& removed)
+    {
+        const uint32_t c  = mEdgeCorner[e];
+        const uint32_t o  = mOpposite[c];
+        const uint32_t v0 = mCornerVertex[Next(c)];
+        const uint32_t v1 = mCornerVertex[Prev(c)];
+
+        thread_local std::vector<uint32_t> fan;
+        fan.clear();
+        ForEachVertexCorner(v0, [&](uint32_t x) { fan.push_back(x); });
+
+        // Glues the two outer neighbors of a removed face, the edge touching
+        // the survivor is kept and the one touching v0 is removed.
+        auto glue = [&](const uint32_t keepCorner, const uint32_t dropCorner) {
+            const uint32_t keep = mCornerEdge[keepCorner];
+            const uint32_t drop = mCornerEdge[dropCorner];
+            const uint32_t ok = mOpposite[keepCorner];
+            const uint32_t od = mOpposite[dropCorner];
+
+            if (ok != InvalidIndex) mOpposite[ok] = od;
+            if (od != InvalidIndex) {
+                mOpposite[od] = ok;
+                mCornerEdge[od] = keep;
+            }
+            mEdgeCorner[keep] = ok != InvalidIndex ? ok : od;
+            mEdgeCorner[drop] = InvalidIndex;
+            removed.push_back(drop);
+        };
+
+        // In face c the corner at v0 faces (v1, vl), the one at v1 faces (vl, v0)
+        const uint32_t oa = mOpposite[Next(c)], ob = mOpposite[Prev(c)];
+        glue(Next(c), Prev(c));
+        uint32_t survivorCorner = oa != InvalidIndex ? Prev(oa) : Next(ob);
+        uint32_t leftCorner     = oa != InvalidIndex ? Next(oa) : Prev(ob);
+
+        uint32_t rightCorner = InvalidIndex;
+        if (o != InvalidIndex) {
+            // In face o the corner at v1 faces (v0, vr), the one at v0 faces (vr, v1)
+            const uint32_t ok = mOpposite[Prev(o)], od = mOpposite[Next(o)];
+            glue(Prev(o), Next(o));
+            rightCorner = ok != InvalidIndex ? Prev(ok) : Next(od);
+        }
+
+        for (auto x : fan) mCornerVertex[x] = v1;
+
+        const uint32_t vl = mCornerVertex[c];
+        const uint32_t vr = o != InvalidIndex ? mCornerVertex[o] : InvalidIndex;
+        for (auto f : {c / 3, o != InvalidIndex ? o / 3 : InvalidIndex}) {
+            if (f == InvalidIndex) continue;
+            for (uint32_t k = 3 * f; k < 3 * f + 3; ++k) {
+                mCornerVertex[k] = InvalidIndex;
+                mOpposite[k] = InvalidIndex;
+            }
+        }
+
+        mEdgeCorner[e] = InvalidIndex;
+        removed.push_back(e);
+
+        mVertexCorner[v1] = survivorCorner;
+        mVertexCorner[vl] = leftCorner;
+        if (vr != InvalidIndex) mVertexCorner[vr] = rightCorner;
+        mVertexCorner[v0] = InvalidIndex;
+        mVertexFlags[v0] |= VertexDeleted;
+    }
+
+    // Builds the table from indexed triangles. Degenerate faces are dropped,
+    // non-manifold edges become boundaries and every extra fan of a
+    // non-manifold vertex gets its own copy of the vertex.
+    inline void Build(const float* positions, const std::size_t nVertices,
+                      const uint32_t* indices, const std::size_t nFaces,
+                      const uint32_t* opposites = nullptr)
+    {
+        mCornerVertex.clear();
+        mCornerVertex.reserve(3 * nFaces);
+        for (std::size_t f = 0; f < nFaces; ++f) {
+            const uint32_t* v = indices + 3 * f;
+            if (v[0] >= nVertices || v[1] >= nVertices || v[2] >= nVertices ||
+                v[0] == v[1] || v[1] == v[2] || v[0] == v[2]) continue;
+            mCornerVertex.insert(mCornerVertex.end(), {v[0], v[1], v[2]});
+        }
+
+        const std::size_t nCorners = mCornerVertex.size();
+        bool valid = opposites && nCorners == 3 * nFaces;
+        for (std::size_t c = 0; valid && c < nCorners; ++c) {
+            const uint32_t o = opposites[c];
+            valid = o == InvalidIndex || (o < nCorners && opposites[o] == c);
+        }
+        if (valid) mOpposite.assign(opposites, opposites + nCorners);
+        else       mOpposite = ComputeOppositeCorners(mCornerVertex.data(), nCorners / 3, nVertices);
+
+        mX.resize(nVertices);
+        mY.resize(nVertices);
+        mZ.resize(nVertices);
+        #pragma omp parallel for
+        for (int64_t v = 0; v < int64_t(nVertices); ++v) {
+            mX[v] = positions[3 * v];
+            mY[v] = positions[3 * v + 1];
+            mZ[v] = positions[3 * v + 2];
+        }
+
+        // Fans are walked serially, they may split vertices
+        mVertexCorner.assign(nVertices, InvalidIndex);
+        std::vector<uint8_t> visited(nCorners, 0);
+        for (uint32_t c = 0; c < nCorners; ++c) {
+            if (visited[c]) continue;
+
+            uint32_t v = mCornerVertex[c];
+            if (mVertexCorner[v] != InvalidIndex) {
+                const uint32_t copy = static_cast<uint32_t>(mX.size());
+                mX.push_back(mX[v]);
+                mY.push_back(mY[v]);
+                mZ.push_back(mZ[v]);
+                mVertexCorner.push_back(InvalidIndex);
+                v = copy;
+            }
+            mVertexCorner[v] = c;
+            ForEachFanCorner(c, [&](uint32_t x) {
+                visited[x] = 1;
+                mCornerVertex[x] = v;
+            });
+        }
+
+        // Edge ids follow the owning corner order, the lower corner of a pair owns it
+        mCornerEdge.resize(nCorners);
+        mEdgeCorner.clear();
+        for (uint32_t c = 0; c < nCorners; ++c) {
+            if (mOpposite[c] != InvalidIndex && mOpposite[c] < c) continue;
+            mCornerEdge[c] = static_cast<uint32_t>(mEdgeCorner.size());
+            mEdgeCorner.push_back(c);
+        }
+        #pragma omp parallel for
+        for (int64_t c = 0; c < int64_t(nCorners); ++c) {
+            const uint32_t o = mOpposite[c];
+            if (o != InvalidIndex && o < c) mCornerEdge[c] = mCornerEdge[o];
+        }
+
+        mVertexQuadric.assign(mX.size(), SymQuadric());
+        mVertexFlags.assign(mX.size(), 0);
+        mFaceQuadric.assign(nCorners / 3, SymQuadric());
+        mEdgeError.assign(mEdgeCorner.size(), QuadricScalar(0));
+        mEdgeNewVertex.assign(mEdgeCorner.size(), Eigen::Vector3f::Zero());
+    }
+
+    // Removes the deleted vertices, faces and edges in place, keeping the
+    // order of the survivors.
+    inline void Compact()
+    {
+        std::vector<uint32_t> vertexMap(NumVertices(), InvalidIndex);
+        uint32_t nVertices = 0;
+        for (uint32_t v = 0; v < NumVertices(); ++v) {
+            if (IsVertexDeleted(v)) continue;
+            vertexMap[v] = nVertices;
+            mX[nVertices] = mX[v];
+            mY[nVertices] = mY[v];
+            mZ[nVertices] = mZ[v];
+            mVertexQuadric[nVertices] = mVertexQuadric[v];
+            mVertexCorner[nVertices] = mVertexCorner[v];
+            mVertexFlags[nVertices] = mVertexFlags[v];
+            ++nVertices;
+        }
+
+        std::vector<uint32_t> faceMap(NumFaces(), InvalidIndex);
+        uint32_t nFaces = 0;
+        for (uint32_t f = 0; f < NumFaces(); ++f) {
+            if (IsFaceDeleted(f)) continue;
+            faceMap[f] = nFaces;
+            for (uint32_t k = 0; k < 3; ++k) {
+                mCornerVertex[3 * nFaces + k] = vertexMap[mCornerVertex[3 * f + k]];
+                mOpposite[3 * nFaces + k] = mOpposite[3 * f + k];
+                mCornerEdge[3 * nFaces + k] = mCornerEdge[3 * f + k];
+            }
+            mFaceQuadric[nFaces] = mFaceQuadric[f];
+            ++nFaces;
+        }
+
+        auto cornerMap = [&](uint32_t c) {
+            return c == InvalidIndex ? InvalidIndex : 3 * faceMap[c / 3] + c % 3;
+        };
+
+        std::vector<uint32_t> edgeMap(NumEdges(), InvalidIndex);
+        uint32_t nEdges = 0;
+        for (uint32_t e = 0; e < NumEdges(); ++e) {
+            if (IsEdgeDeleted(e)) continue;
+            edgeMap[e] = nEdges;
+            mEdgeCorner[nEdges] = cornerMap(mEdgeCorner[e]);
+            mEdgeError[nEdges] = mEdgeError[e];
+            mEdgeNewVertex[nEdges] = mEdgeNewVertex[e];
+            ++nEdges;
+        }
+
+        for (uint32_t c = 0; c < 3 * nFaces; ++c) {
+            mOpposite[c] = cornerMap(mOpposite[c]);
+            mCornerEdge[c] = edgeMap[mCornerEdge[c]];
+        }
+        for (uint32_t v = 0; v < nVertices; ++v)
+            mVertexCorner[v] = cornerMap(mVertexCorner[v]);
+
+        for (auto* a : {&mX, &mY, &mZ}) a->resize(nVertices);
+        mVertexQuadric.resize(nVertices);
+        mVertexCorner.resize(nVertices);
+        mVertexFlags.resize(nVertices);
+        mCornerVertex.resize(3 * nFaces);
+        mOpposite.resize(3 * nFaces);
+        mCornerEdge.resize(3 * nFaces);
+        mFaceQuadric.resize(nFaces);
+        mEdgeCorner.resize(nEdges);
+        mEdgeError.resize(nEdges);
+        mEdgeNewVertex.resize(nEdges);
+    }
+
+    // Indexed triangle arrays, deleted elements are skipped
+    inline void Flatten(std::vector<float>& positions, std::vector<uint32_t>& indices) const
+    {
+        std::vector<uint32_t> vertexMap(NumVertices(), InvalidIndex);
+        positions.clear();
+        indices.clear();
+        positions.reserve(3 * NumVertices());
+        indices.reserve(mCornerVertex.size());
+
+        uint32_t next = 0;
+        for (uint32_t v = 0; v < NumVertices(); ++v) {
+            if (IsVertexDeleted(v)) continue;
+            positions.insert(positions.end(), {mX[v], mY[v], mZ[v]});
+            vertexMap[v] = next++;
+        }
+        for (uint32_t f = 0; f < NumFaces(); ++f) {
+            if (IsFaceDeleted(f)) continue;
+            for (uint32_t k = 0; k < 3; ++k) indices.push_back(vertexMap[mCornerVertex[3 * f + k]]);
+        }
+    }
+};
+
+// Kernel interface, see the OpenMesh counterparts in mesh.h
+
+inline std::size_t NumVertices(const FlatMesh& mesh) { return mesh.NumVertices(); }
+inline std::size_t NumEdges(const FlatMesh& mesh)    { return mesh.NumEdges(); }
+inline std::size_t NumFaces(const FlatMesh& mesh)    { return mesh.NumFaces(); }
+
+inline void PrepareMesh(FlatMesh&) {}
+
+inline void UpdateFaceQuadric(FlatMesh& mesh, const uint32_t f)
+{
+    const uint32_t* v = &mesh.mCornerVertex[3 * f];
+    mesh.mFaceQuadric[f] = SymQuadric::FromPlane(
+        EvaluateFacePlane(mesh.Point(v[0]), mesh.Point(v[1]), mesh.Point(v[2]))
+    );
+}
+
+// Deleted faces get a zero quadric
+inline void UpdateFaceQuadrics(FlatMesh& mesh, const uint32_t begin, const uint32_t end)
+{
+    FaceBlock block;
+
+    for (uint32_t first = begin; first < end; first += QUADRIC_BLOCK) {
+        const uint32_t count = std::min(end - first, QUADRIC_BLOCK);
+        for (uint32_t i = 0; i < count; ++i) {
+            const uint32_t* v = &mesh.mCornerVertex[3 * (first + i)];
+            const bool deleted = v[0] == InvalidIndex;
+            for (int k = 0; k < 3; ++k) {
+                block.mX[k][i] = deleted ? 0.0f : mesh.mX[v[k]];
+                block.mY[k][i] = deleted ? 0.0f : mesh.mY[v[k]];
+                block.mZ[k][i] = deleted ? 0.0f : mesh.mZ[v[k]];
+            }
+        }
+
+        ComputeFaceQuadrics(block, count, mesh.mFaceQuadric.data() + first);
+    }
+}
+
+inline void UpdateVertexQuadric(FlatMesh& mesh, const uint32_t v)
+{
+    SymQuadric result;
+    mesh.ForEachVertexCorner(v, [&](uint32_t c) { result += mesh.mFaceQuadric[c / 3]; });
+    mesh.mVertexQuadric[v] = result;
+}
+
+template <Placement P>
+inline uint32_t UpdateEdgeError(FlatMesh& mesh, const uint32_t e)
+{
+    auto [v0, v1] = mesh.EdgeVertices(e);
+    SymQuadric Q = mesh.mVertexQuadric[v0] + mesh.mVertexQuadric[v1];
+    bool fellBack = false;
+    SymQuadric::Vector3 newV = EvaluateNewBestVertex<P>(mesh.Point(v0).cast<QuadricScalar>(),
+                                                        mesh.Point(v1).cast<QuadricScalar>(), Q, &fellBack);
+
+    mesh.mEdgeError[e] = Q.Evaluate(newV);
+    mesh.mEdgeNewVertex[e] = newV.cast<float>();
+    return fellBack;
+}
+
+template <Placement P, typename EdgeAt>
+inline uint32_t UpdateEdgeErrorBlocks(FlatMesh& mesh, const std::size_t count, EdgeAt edgeAt)
+{
+    EdgeBlock block;
+    EdgeSolution solution;
+    uint32_t fallbacks = 0;
+
+    for (std::size_t first = 0; first < count; first += QUADRIC_BLOCK) {
+        const uint32_t n = std::min<std::size_t>(count - first, QUADRIC_BLOCK);
+        for (uint32_t i = 0; i < n; ++i) {
+            const auto ends = mesh.EdgeVertices(edgeAt(first + i));
+            const SymQuadric& q0 = mesh.mVertexQuadric[ends[0]];
+            const SymQuadric& q1 = mesh.mVertexQuadric[ends[1]];
+            for (int j = 0; j < 10; ++j) block.mQ[j][i] = q0.m[j] + q1.m[j];
+            for (int k = 0; k < 2; ++k) {
+                block.mP[k][0][i] = mesh.mX[ends[k]];
+                block.mP[k][1][i] = mesh.mY[ends[k]];
+                block.mP[k][2][i] = mesh.mZ[ends[k]];
+            }
+        }
+
+        fallbacks += SolveEdgeQuadrics<P>(block, n, solution);
+        for (uint32_t i = 0; i < n; ++i) {
+            const uint32_t e = edgeAt(first + i);
+            mesh.mEdgeError[e] = solution.mError[i];
+            mesh.mEdgeNewVertex[e] = Eigen::Vector3f(solution.mX[i], solution.mY[i], solution.mZ[i]);
+        }
+    }
+    return fallbacks;
+}
+
+template <Placement P>
+inline uint32_t UpdateEdgeErrors(FlatMesh& mesh, const uint32_t begin, const uint32_t end)
+{
+    return UpdateEdgeErrorBlocks<P>(mesh, end - begin, [&](std::size_t i) { return uint32_t(begin + i); });
+}
+
+template <Placement P>
+inline uint32_t UpdateEdgeErrors(FlatMesh& mesh, std::span<const uint32_t> edges)
+{
+    return UpdateEdgeErrorBlocks<P>(mesh, edges.size(), [&](std::size_t i) { return edges[i]; });
+}
+
+inline QuadricScalar EdgeError(const FlatMesh& mesh, const uint32_t e) { return mesh.mEdgeError[e]; }
+
+inline std::array<uint32_t, 2> EdgeVertices(const FlatMesh& mesh, const uint32_t e)
+{
+    return mesh.EdgeVertices(e);
+}
+
+inline bool IsBoundaryEdge(const FlatMesh& mesh, const uint32_t e) { return mesh.IsBoundaryEdge(e); }
+
+inline bool IsEdgeLocked(const FlatMesh& mesh, const uint32_t e)
+{
+    auto [v0, v1] = mesh.EdgeVertices(e);
+    return mesh.IsVertexLocked(v0) || mesh.IsVertexLocked(v1);
+}
+
+inline CollapseCheck CheckCollapseEdge(FlatMesh& mesh, const uint32_t e)
+{
+    if (mesh.mEdgeCorner[e] == InvalidIndex)
+        return CollapseCheck::DeletedEdge;
+
+    auto [v0, v1] = mesh.EdgeVertices(e);
+    if (mesh.IsVertexDeleted(v0) || mesh.IsVertexDeleted(v1))
+        return CollapseCheck::DeletedVertex;
+
+    if (!mesh.IsCollapseOk(e))
+        return CollapseCheck::Topology;
+
+    if (IsEdgeLocked(mesh, e))
+        return CollapseCheck::Locked;
+
+    return CollapseCheck::Ok;
+}
+
+inline bool CanCollapseEdge(FlatMesh& mesh, const uint32_t e)
+{
+    return CheckCollapseEdge(mesh, e) == CollapseCheck::Ok;
+}
+
+inline uint32_t CollapseEdge(FlatMesh& mesh, const uint32_t e, std::vector<uint32_t>& removed)
+{
+    auto [v0, v1] = mesh.EdgeVertices(e);
+    mesh.SetPoint(v1, mesh.mEdgeNewVertex[e]);
+    mesh.mVertexQuadric[v1] += mesh.mVertexQuadric[v0];
+    mesh.Collapse(e, removed);
+    return v1;
+}
+
+inline void CollectDirtyEdges(FlatMesh& mesh, const uint32_t v, const bool accumulate,
+                              std::vector<uint32_t>& dirty)
+{
+    if (accumulate) {
+        // Same walk as ForEachVertexVertex, the edge to the next vertex is
+        // opposite to the previous corner.
+        mesh.ForEachVertexCorner(v, [&](uint32_t c) {
+            dirty.push_back(mesh.mCornerEdge[FlatMesh::Prev(c)]);
+            if (mesh.mOpposite[FlatMesh::Next(c)] == InvalidIndex)
+                dirty.push_back(mesh.mCornerEdge[FlatMesh::Next(c)]);
+        });
+        return;
+    }
+
+    mesh.ForEachVertexCorner(v, [&](uint32_t c) { UpdateFaceQuadric(mesh, c / 3); });
+    mesh.ForEachVertexCorner(v, [&](uint32_t c) {
+        const uint32_t f = c / 3;
+        for (uint32_t k = 3 * f; k < 3 * f + 3; ++k) {
+            UpdateVertexQuadric(mesh, mesh.mCornerVertex[k]);
+            dirty.push_back(mesh.mCornerEdge[k]);
+        }
+    });
+}
+
+template <typename Fn>
+inline void ForEachVertexVertex(const FlatMesh& mesh, const uint32_t v, Fn fn)
+{
+    mesh.ForEachVertexVertex(v, fn);
+}
+
+inline void CompactMesh(FlatMesh& mesh)
+{
+    mesh.Compact();
+}
+
+#endif // !FLAT_MESH_H
@@ -0,0 +1,408 @@
+#ifndef GENERATE_H
+#define GENERATE_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Procedural meshes for benchmark inputs, built straight into indexed
+// triangle arrays (the layout of BuildMeshFromArrays and ExportMesh).
+//
+// Every random value is a hash of the seed and an element index, not a
+// draw from a <random> distribution, so a mesh only depends on its options
+// and is the same across runs, thread counts and standard libraries.
+
+enum class MeshShape { Icosphere, Terrain, Torus, Grid };
+
+inline bool ParseMeshShape(const std::string& name, MeshShape& shape)
+{
+    if (name == "icosphere") { shape = MeshShape::Icosphere; return true; }
+    if (name == "terrain")   { shape = MeshShape::Terrain;   return true; }
+    if (name == "torus")     { shape = MeshShape::Torus;     return true; }
+    if (name == "grid")      { shape = MeshShape::Grid;      return true; }
+    return false;
+}
+
+inline const char* MeshShapeName(const MeshShape shape)
+{
+    switch (shape) {
+        case MeshShape::Icosphere: return "icosphere";
+        case MeshShape::Terrain:   return "terrain";
+        case MeshShape::Torus:     return "torus";
+        default:                   return "grid";
+    }
+}
+
+struct GeneratorOptions {
+    MeshShape mShape = MeshShape::Icosphere;
+    uint64_t  mFaces = 1 << 20;  // exact for grid, closest reachable otherwise
+    uint64_t  mSeed  = 1;
+    float     mNoise = 0.0f;     // displacement relative to the edge length
+    uint32_t  mHoles = 8;        // torus only
+};
+
+// "shape:faces[:seed]", e.g. icosphere:1000000:7, the other options keep
+// their defaults
+inline bool ParseGeneratorSpec(const std::string& spec, GeneratorOptions& options)
+{
+    const std::size_t first = spec.find(':');
+    if (first == std::string::npos || !ParseMeshShape(spec.substr(0, first), options.mShape))
+        return false;
+
+    const std::size_t second = spec.find(':', first + 1);
+    try {
+        options.mFaces = std::stoull(spec.substr(first + 1, second - first - 1));
+        if (second != std::string::npos)
+            options.mSeed = std::stoull(spec.substr(second + 1));
+    } catch (const std::exception&) {
+        return false;
+    }
+    return true;
+}
+
+// SplitMix64 finalizer
+inline uint64_t HashMix(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// Uniform in [-1, 1) from the seed and an element index
+inline float HashSigned(const uint64_t seed, const uint64_t index)
+{
+    const uint64_t bits = HashMix(HashMix(seed) ^ index) >> 40;
+    return float(bits) * (2.0f / float(1 << 24)) - 1.0f;
+}
+
+// Value noise in about [-1, 1], lattice values hashed from the seed and
+// blended with smoothstep, octaves halving in amplitude.
+inline float FractalNoise(const uint64_t seed, const float x, const float y, const int octaves = 6)
+{
+    auto lattice = [&](const int64_t i, const int64_t j, const int octave) {
+        return HashSigned(seed + uint64_t(octave), uint64_t(i) * 0x9E3779B1ull ^ uint64_t(j) * 0x85EBCA77ull);
+    };
+    auto smooth = [](const float t) { return t * t * (3.0f - 2.0f * t); };
+
+    float sum = 0.0f, amplitude = 0.5f, frequency = 1.0f;
+    for (int o = 0; o < octaves; ++o) {
+        const float fx = x * frequency, fy = y * frequency;
+        const int64_t ix = int64_t(std::floor(fx)), iy = int64_t(std::floor(fy));
+        const float tx = smooth(fx - float(ix)), ty = smooth(fy - float(iy));
+
+        const float v0 = lattice(ix, iy, o)     + tx * (lattice(ix + 1, iy, o)     - lattice(ix, iy, o));
+        const float v1 = lattice(ix, iy + 1, o) + tx * (lattice(ix + 1, iy + 1, o) - lattice(ix, iy + 1, o));
+        sum += amplitude * (v0 + ty * (v1 - v0));
+
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+    }
+    return sum;
+}
+
+// Drops the vertices no face references and remaps the indices
+inline void RemoveUnreferencedVertices(std::vector<float>& positions, std::vector<uint32_t>& indices)
+{
+    std::vector<uint32_t> remap(positions.size() / 3, UINT32_MAX);
+    for (auto v : indices) remap[v] = 0;
+
+    uint32_t next = 0;
+    for (std::size_t v = 0; v < remap.size(); ++v) {
+        if (remap[v] == UINT32_MAX) continue;
+        for (int k = 0; k < 3; ++k) positions[3 * next + k] = positions[3 * v + k];
+        remap[v] = next++;
+    }
+    positions.resize(3 * std::size_t(next));
+    for (auto& v : indices) v = remap[v];
+}
+
+// Geodesic sphere: every face of the icosahedron split into a frequency x
+// frequency triangular grid and projected on the unit sphere, 20 f^2
+// faces. A power of two frequency 2^k is k midpoint subdivisions. Vertices
+// are shared along the icosahedron edges, the result is closed.
+inline void GenerateIcosphere(const uint32_t frequency, const uint64_t seed, const float noise,
+                              std::vector<float>& positions, std::vector<uint32_t>& indices)
+{
+    const float t = (1.0f + std::sqrt(5.0f)) / 2.0f;
+    const std::array<std::array<float, 3>, 12> corners = {{
+        {-1,  t,  0}, { 1,  t,  0}, {-1, -t,  0}, { 1, -t,  0},
+        { 0, -1,  t}, { 0,  1,  t}, { 0, -1, -t}, { 0,  1, -t},
+        { t,  0, -1}, { t,  0,  1}, {-t,  0, -1}, {-t,  0,  1}
+    }};
+    const std::array<std::array<uint32_t, 3>, 20> faces = {{
+        {0, 11, 5}, {0, 5, 1},  {0, 1, 7},   {0, 7, 10}, {0, 10, 11},
+        {1, 5, 9},  {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+        {3, 9, 4},  {3, 4, 2},  {3, 2, 6},   {3, 6, 8},  {3, 8, 9},
+        {4, 9, 5},  {2, 4, 11}, {6, 2, 10},  {8, 6, 7},  {9, 8, 1}
+    }};
+
+    // The 30 edges, each with frequency - 1 inner vertices running from
+    // its lower corner to its higher one
+    std::vector<std::array<uint32_t, 2>> edges;
+    for (const auto& f : faces) {
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t a = std::min(f[k], f[(k + 1) % 3]), b = std::max(f[k], f[(k + 1) % 3]);
+            if (std::find(edges.begin(), edges.end(), std::array<uint32_t, 2>{a, b}) == edges.end())
+                edges.push_back({a, b});
+        }
+    }
+
+    const uint32_t n = std::max<uint32_t>(frequency, 1);
+    const std::size_t edgeInner = n - 1;
+    const std::size_t faceInner = std::size_t(n - 1) * (n > 1 ? n - 2 : 0) / 2;
+    const std::size_t edgeBase = corners.size();
+    const std::size_t faceBase = edgeBase + edges.size() * edgeInner;
+    const std::size_t nVertices = faceBase + faces.size() * faceInner;
+
+    positions.assign(3 * nVertices, 0.0f);
+    indices.resize(3 * faces.size() * std::size_t(n) * n);
+
+    auto store = [&](const std::size_t v, float x, float y, float z) {
+        const float len = std::sqrt(x * x + y * y + z * z);
+        const float radius = 1.0f + noise * HashSigned(seed, v) * (1.0f / float(n));
+        positions[3 * v + 0] = x / len * radius;
+        positions[3 * v + 1] = y / len * radius;
+        positions[3 * v + 2] = z / len * radius;
+    };
+    auto lerp = [&](const std::array<float, 3>& a, const std::array<float, 3>& b, const float s, const int k) {
+        return a[k] + s * (b[k] - a[k]);
+    };
+
+    for (std::size_t c = 0; c < corners.size(); ++c)
+        store(c, corners[c][0], corners[c][1], corners[c][2]);
+
+    for (std::size_t e = 0; e < edges.size(); ++e) {
+        const auto& a = corners[edges[e][0]];
+        const auto& b = corners[edges[e][1]];
+        for (uint32_t k = 1; k < n; ++k) {
+            const float s = float(k) / float(n);
+            store(edgeBase + e * edgeInner + (k - 1), lerp(a, b, s, 0), lerp(a, b, s, 1), lerp(a, b, s, 2));
+        }
+    }
+
+    // k-th vertex from corner a towards corner b
+    auto edgeVertex = [&](const uint32_t a, const uint32_t b, const uint32_t k) -> uint32_t {
+        if (k == 0) return a;
+        if (k == n) return b;
+        const std::array<uint32_t, 2> key = {std::min(a, b), std::max(a, b)};
+        const std::size_t e = std::find(edges.begin(), edges.end(), key) - edges.begin();
+        return uint32_t(edgeBase + e * edgeInner + (a < b ? k : n - k) - 1);
+    };
+
+    // Interior (i, j), i > 0, j > 0, i + j < n, numbered by rows of j
+    auto innerOffset = [&](const uint32_t i, const uint32_t j) -> std::size_t {
+        const std::size_t rowsBefore = std::size_t(j - 1) * (n - 1) - std::size_t(j - 1) * j / 2;
+        return rowsBefore + (i - 1);
+    };
+
+    #pragma omp parallel for
+    for (int f = 0; f < int(faces.size()); ++f) {
+        const uint32_t c0 = faces[f][0], c1 = faces[f][1], c2 = faces[f][2];
+        const std::size_t base = faceBase + std::size_t(f) * faceInner;
+
+        // Vertex at c0 + i/n (c1 - c0) + j/n (c2 - c0)
+        auto vertex = [&](const uint32_t i, const uint32_t j) -> uint32_t {
+            if (j == 0)     return edgeVertex(c0, c1, i);
+            if (i == 0)     return edgeVertex(c0, c2, j);
+            if (i + j == n) return edgeVertex(c1, c2, j);
+            return uint32_t(base + innerOffset(i, j));
+        };
+
+        for (uint32_t j = 1; j < n; ++j) {
+            for (uint32_t i = 1; i + j < n; ++i) {
+                const float s = float(i) / float(n), r = float(j) / float(n);
+                float p[3];
+                for (int k = 0; k < 3; ++k)
+                    p[k] = corners[c0][k] + s * (corners[c1][k] - corners[c0][k]) + r * (corners[c2][k] - corners[c0][k]);
+                store(base + innerOffset(i, j), p[0], p[1], p[2]);
+            }
+        }
+
+        std::size_t out = 3 * std::size_t(f) * n * n;
+        for (uint32_t j = 0; j < n; ++j) {
+            for (uint32_t i = 0; i + j < n; ++i) {
+                indices[out++] = vertex(i, j);
+                indices[out++] = vertex(i + 1, j);
+                indices[out++] = vertex(i, j + 1);
+                if (i + j + 1 < n) {
+                    indices[out++] = vertex(i + 1, j);
+                    indices[out++] = vertex(i + 1, j + 1);
+                    indices[out++] = vertex(i, j + 1);
+                }
+            }
+        }
+    }
+}
+
+// Height field over a cols x rows grid of the unit square, fractal value
+// noise heights, 2 cols rows faces with an open boundary.
+inline void GenerateTerrain(const uint32_t cols, const uint32_t rows, const uint64_t seed, const float noise,
+                            std::vector<float>& positions, std::vector<uint32_t>& indices)
+{
+    const uint32_t w = cols + 1;
+    positions.resize(3 * std::size_t(w) * (rows + 1));
+    indices.resize(6 * std::size_t(cols) * rows);
+
+    #pragma omp parallel for
+    for (int y = 0; y <= int(rows); ++y) {
+        for (uint32_t x = 0; x < w; ++x) {
+            const std::size_t v = std::size_t(y) * w + x;
+            const float u = float(x) / float(cols), t = float(y) / float(rows);
+            positions[3 * v + 0] = u;
+            positions[3 * v + 1] = t;
+            positions[3 * v + 2] = 0.25f * FractalNoise(seed, 8.0f * u, 8.0f * t)
+                                 + noise * HashSigned(seed, v) / float(std::max(cols, rows));
+        }
+    }
+
+    #pragma omp parallel for
+    for (int y = 0; y < int(rows); ++y) {
+        for (uint32_t x = 0; x < cols; ++x) {
+            const uint32_t v00 = y * w + x, v10 = v00 + 1, v01 = v00 + w, v11 = v01 + 1;
+            uint32_t* out = &indices[6 * (std::size_t(y) * cols + x)];
+            out[0] = v00; out[1] = v10; out[2] = v11;
+            out[3] = v00; out[4] = v11; out[5] = v01;
+        }
+    }
+}
+
+// Torus with major radius 1 and minor radius 0.35 over a ring x tube grid,
+// 2 ring tube faces before the holes. Holes are discs of the parameter
+// domain, one per sector of the ring so they never touch, their faces are
+// removed and leave boundary loops.
+inline void GenerateTorus(const uint32_t ring, const uint32_t tube, const uint32_t holes, const uint64_t seed,
+                          const float noise, std::vector<float>& positions, std::vector<uint32_t>& indices)
+{
+    const float R = 1.0f, r = 0.35f, tau = 6.28318530718f;
+    positions.resize(3 * std::size_t(ring) * tube);
+
+    #pragma omp parallel for
+    for (int a = 0; a < int(ring); ++a) {
+        const float theta = tau * float(a) / float(ring);
+        for (uint32_t b = 0; b < tube; ++b) {
+            const std::size_t v = std::size_t(a) * tube + b;
+            const float phi = tau * float(b) / float(tube);
+            const float rr = r * (1.0f + noise * HashSigned(seed, v) / float(tube));
+            positions[3 * v + 0] = (R + rr * std::cos(phi)) * std::cos(theta);
+            positions[3 * v + 1] = (R + rr * std::cos(phi)) * std::sin(theta);
+            positions[3 * v + 2] = rr * std::sin(phi);
+        }
+    }
+
+    // Disc centers and radius in cells, at least 2 cells wide and at most
+    // a third of a ring sector
+    std::vector<std::array<float, 2>> centers;
+    const float sector = holes ? float(ring) / float(holes) : 0.0f;
+    const float radius = std::min(sector / 3.0f, float(tube) / 6.0f);
+    if (radius >= 2.0f) {
+        for (uint32_t h = 0; h < holes; ++h) {
+            const float a = sector * (float(h) + 0.5f + 0.1f * HashSigned(seed ^ 0x686F6C65ull, 2 * h));
+            const float b = float(tube) * 0.5f * (1.0f + HashSigned(seed ^ 0x686F6C65ull, 2 * h + 1));
+            centers.push_back({a, b});
+        }
+    }
+
+    auto inHole = [&](const uint32_t a, const uint32_t b) {
+        for (const auto& c : centers) {
+            const float da = float(a) + 0.5f - c[0];
+            float db = std::fabs(float(b) + 0.5f - c[1]);
+            db = std::min(db, float(tube) - db);
+            if (da * da + db * db < radius * radius) return true;
+        }
+        return false;
+    };
+
+    indices.clear();
+    indices.reserve(6 * std::size_t(ring) * tube);
+    for (uint32_t a = 0; a < ring; ++a) {
+        for (uint32_t b = 0; b < tube; ++b) {
+            if (inHole(a, b)) continue;
+            const uint32_t a1 = (a + 1) % ring, b1 = (b + 1) % tube;
+            const uint32_t v00 = a * tube + b, v10 = a1 * tube + b, v01 = a * tube + b1, v11 = a1 * tube + b1;
+            indices.insert(indices.end(), {v00, v10, v11, v00, v11, v01});
+        }
+    }
+    RemoveUnreferencedVertices(positions, indices);
+}
+
+// Planar grid of exactly faces triangles: full rows of cols quads, the
+// remainder as a partial row whose last quad may hold a single triangle.
+inline void GenerateGrid(const uint64_t faces, const uint64_t seed, const float noise,
+                         std::vector<float>& positions, std::vector<uint32_t>& indices)
+{
+    const uint64_t target = std::max<uint64_t>(faces, 1);
+    const uint32_t cols = std::max<uint32_t>(1, uint32_t(std::lround(std::sqrt(double(target) / 2.0))));
+    const uint32_t rows = uint32_t(target / (2 * uint64_t(cols)));
+    const uint32_t rest = uint32_t(target - 2 * uint64_t(cols) * rows);
+    const uint32_t w = cols + 1;
+
+    // The partial row needs one vertex per quad, plus the closing one when
+    // its last quad is complete
+    const uint32_t restQuads = (rest + 1) / 2;
+    const uint32_t restVertices = rest ? restQuads + (rest % 2 == 0) : 0;
+    const std::size_t nVertices = std::size_t(w) * (rows + 1) + restVertices;
+    const float spacing = 1.0f / float(cols);
+
+    positions.resize(3 * nVertices);
+    for (std::size_t v = 0; v < nVertices; ++v) {
+        const std::size_t x = v < std::size_t(w) * (rows + 1) ? v % w : v - std::size_t(w) * (rows + 1);
+        const std::size_t y = v < std::size_t(w) * (rows + 1) ? v / w : rows + 1;
+        positions[3 * v + 0] = float(x) * spacing;
+        positions[3 * v + 1] = float(y) * spacing;
+        positions[3 * v + 2] = noise * spacing * HashSigned(seed, v);
+    }
+
+    indices.resize(3 * target);
+    std::size_t out = 0;
+    for (uint32_t y = 0; y < rows; ++y) {
+        for (uint32_t x = 0; x < cols; ++x) {
+            const uint32_t v00 = y * w + x, v10 = v00 + 1, v01 = v00 + w, v11 = v01 + 1;
+            for (uint32_t v : {v00, v10, v11, v00, v11, v01}) indices[out++] = v;
+        }
+    }
+
+    const uint32_t top = uint32_t(std::size_t(w) * (rows + 1));
+    for (uint32_t q = 0; q < restQuads; ++q) {
+        const uint32_t v00 = rows * w + q, v10 = v00 + 1, v01 = top + q;
+        if (2 * q + 1 == rest) {
+            for (uint32_t v : {v00, v10, v01}) indices[out++] = v;
+        } else {
+            const uint32_t v11 = v01 + 1;
+            for (uint32_t v : {v00, v10, v11, v00, v11, v01}) indices[out++] = v;
+        }
+    }
+}
+
+// Shape sized after options.mFaces: exact for the grid, the closest face
+// count of the shape otherwise (torus holes remove a few more).
+inline void GenerateMesh(const GeneratorOptions& options, std::vector<float>& positions, std::vector<uint32_t>& indices)
+{
+    const double faces = double(std::max<uint64_t>(options.mFaces, 1));
+    switch (options.mShape) {
+        case MeshShape::Icosphere: {
+            const uint32_t frequency = std::max<uint32_t>(1, uint32_t(std::lround(std::sqrt(faces / 20.0))));
+            GenerateIcosphere(frequency, options.mSeed, options.mNoise, positions, indices);
+            break;
+        }
+        case MeshShape::Terrain: {
+            const uint32_t side = std::max<uint32_t>(1, uint32_t(std::lround(std::sqrt(faces / 2.0))));
+            GenerateTerrain(side, side, options.mSeed, options.mNoise, positions, indices);
+            break;
+        }
+        case MeshShape::Torus: {
+            const uint32_t tube = std::max<uint32_t>(3, uint32_t(std::lround(std::sqrt(faces / 4.0))));
+            GenerateTorus(2 * tube, tube, options.mHoles, options.mSeed, options.mNoise, positions, indices);
+            break;
+        }
+        case MeshShape::Grid:
+            GenerateGrid(options.mFaces, options.mSeed, options.mNoise, positions, indices);
+            break;
+    }
+}
+
+#endif // !GENERATE_H
@@ -0,0 +1,188 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "massert.h"
+
+// Addressable min-heap over the ids [0, capacity). Every id appears at most
+// once and carries its own key, so updating an element is a sift instead of
+// a new push, and the ordering never depends on data changed outside the heap.
+template <typename Key = double, std::size_t Arity = 4>
+class IndexedHeap {
+    static_assert(Arity >= 2, "Heap arity must be at least 2");
+
+public:
+    static constexpr uint32_t InvalidPosition = std::numeric_limits<uint32_t>::max();
+
+    explicit IndexedHeap(std::size_t capacity = 0)
+        : mPosition(capacity, InvalidPosition)
+    {}
+
+    inline bool        Empty()    const { return mHeap.empty(); }
+    inline std::size_t Size()     const { return mHeap.size(); }
+    inline std::size_t Capacity() const { return mPosition.size(); }
+
+    inline bool Contains(const uint32_t id) const
+    {
+        return id < mPosition.size() && mPosition[id] != InvalidPosition;
+    }
+
+    inline uint32_t Top()    const { return mHeap.front().mId; }
+    inline Key      TopKey() const { return mHeap.front().mKey; }
+
+    inline void Resize(const std::size_t capacity)
+    {
+        mPosition.resize(capacity, InvalidPosition);
+    }
+
+    inline void Clear()
+    {
+        for (const auto& entry : mHeap)
+            mPosition[entry.mId] = InvalidPosition;
+        mHeap.clear();
+    }
+
+    // Insert id with the given key, or move it if it is already in the heap
+    inline void Update(const uint32_t id, const Key key)
+    {
+        ASSERT(id < mPosition.size(), "Heap id out of capacity");
+
+        uint32_t pos = mPosition[id];
+        if (pos == InvalidPosition) {
+            pos = static_cast<uint32_t>(mHeap.size());
+            mHeap.push_back({key, id});
+            mPosition[id] = pos;
+            SiftUp(pos);
+        } else {
+            const Key old = mHeap[pos].mKey;
+            mHeap[pos].mKey = key;
+            if (key < old) SiftUp(pos);
+            else           SiftDown(pos);
+        }
+    }
+
+    inline void Remove(const uint32_t id)
+    {
+        if (!Contains(id)) return;
+        RemoveAt(mPosition[id]);
+    }
+
+    // Replace the content with the ids [0, count), id i keyed by key(i), using
+    // a bottom-up heapify. The nodes of one level have disjoint subtrees, so
+    // each level is sifted with an orphaned omp for: call it from every thread
+    // of a parallel region to share the work, or outside of one to run serially.
+    template <typename KeyFn>
+    inline void Build(const std::size_t count, KeyFn key)
+    {
+        #pragma omp single
+        {
+            ASSERT(count <= std::numeric_limits<uint32_t>::max(), "Heap ids must fit in 32 bits");
+            if (mPosition.size() < count) mPosition.resize(count);
+            mHeap.resize(count);
+        }
+
+        #pragma omp for
+        for (std::size_t i = 0; i < count; ++i) {
+            mHeap[i] = {key(static_cast<uint32_t>(i)), static_cast<uint32_t>(i)};
+            mPosition[i] = static_cast<uint32_t>(i);
+        }
+
+        #pragma omp for
+        for (std::size_t i = count; i < mPosition.size(); ++i) {
+            mPosition[i] = InvalidPosition;
+        }
+
+        if (count < 2) return;
+
+        std::vector<std::size_t> levels = {0};
+        const std::size_t lastParent = (count - 2) / Arity;
+        while (levels.back() <= lastParent)
+            levels.push_back(levels.back() * Arity + 1);
+
+        for (std::size_t l = levels.size() - 1; l-- > 0;) {
+            const std::size_t end = std::min(levels[l + 1], lastParent + 1);
+
+            #pragma omp for
+            for (std::size_t i = levels[l]; i < end; ++i) {
+                SiftDown(i);
+            }
+        }
+    }
+
+    inline uint32_t Pop()
+    {
+        ASSERT(!mHeap.empty(), "Pop on empty heap");
+        const uint32_t id = mHeap.front().mId;
+        RemoveAt(0);
+        return id;
+    }
+
+private:
+    struct Entry {
+        Key      mKey;
+        uint32_t mId;
+    };
+
+    std::vector<Entry>    mHeap;
+    std::vector<uint32_t> mPosition;
+
+    inline void Place(const std::size_t pos, const Entry& entry)
+    {
+        mHeap[pos] = entry;
+        mPosition[entry.mId] = static_cast<uint32_t>(pos);
+    }
+
+    inline void RemoveAt(const std::size_t pos)
+    {
+        mPosition[mHeap[pos].mId] = InvalidPosition;
+        const Entry last = mHeap.back();
+        mHeap.pop_back();
+        if (pos == mHeap.size()) return;
+
+        const Key old = mHeap[pos].mKey;
+        Place(pos, last);
+        if (last.mKey < old) SiftUp(pos);
+        else                 SiftDown(pos);
+    }
+
+    inline void SiftUp(std::size_t pos)
+    {
+        const Entry entry = mHeap[pos];
+        while (pos > 0) {
+            const std::size_t parent = (pos - 1) / Arity;
+            if (!(entry.mKey < mHeap[parent].mKey)) break;
+            Place(pos, mHeap[parent]);
+            pos = parent;
+        }
+        Place(pos, entry);
+    }
+
+    inline void SiftDown(std::size_t pos)
+    {
+        const Entry entry = mHeap[pos];
+        const std::size_t size = mHeap.size();
+        while (true) {
+            const std::size_t first = pos * Arity + 1;
+            if (first >= size) break;
+
+            const std::size_t last = first + Arity < size ? first + Arity : size;
+            std::size_t best = first;
+            for (std::size_t child = first + 1; child < last; ++child) {
+                if (mHeap[child].mKey < mHeap[best].mKey) best = child;
+            }
+
+            if (!(mHeap[best].mKey < entry.mKey)) break;
+            Place(pos, mHeap[best]);
+            pos = best;
+        }
+        Place(pos, entry);
+    }
+};
+
+#endif // !HEAP_H
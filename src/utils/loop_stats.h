@@ -0,0 +1,60 @@
+#ifndef LOOP_STATS_H
+#define LOOP_STATS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Outcome of CheckCollapseEdge for a popped edge, anything but Ok rejects it
+enum class CollapseCheck { Ok, DeletedEdge, DeletedVertex, Topology, Locked, Count };
+
+constexpr std::size_t COLLAPSE_CHECK_COUNT = static_cast<std::size_t>(CollapseCheck::Count);
+
+inline const char* CollapseCheckName(const CollapseCheck check)
+{
+    switch (check) {
+        case CollapseCheck::Ok:            return "ok";
+        case CollapseCheck::DeletedEdge:   return "deleted_edge";
+        case CollapseCheck::DeletedVertex: return "deleted_vertex";
+        case CollapseCheck::Topology:      return "topology";
+        case CollapseCheck::Locked:        return "locked";
+        default:                           return "unknown";
+    }
+}
+
+// The collapse loop reads the clock at most every LOOP_SAMPLE_COLLAPSES
+// collapses and keeps a sample every LOOP_SAMPLE_MS
+constexpr uint64_t LOOP_SAMPLE_COLLAPSES = 1024;
+constexpr double   LOOP_SAMPLE_MS        = 100.0;
+
+struct LoopSample {
+    double   mMs        = 0.0; // since the loop started, over all RunUntil
+    uint64_t mCollapses = 0;
+};
+
+// Counters of the collapse loop, a few increments per heap pop so they are
+// always on. Stale pops are edges, or endpoints, deleted since they were
+// scored.
+struct LoopStats {
+    uint64_t                                   mPops          = 0;
+    std::array<uint64_t, COLLAPSE_CHECK_COUNT> mChecks        = {}; // pops by CollapseCheck
+    uint64_t                                   mDeferred      = 0;  // mp_v3 neighborhood conflicts, pushed back
+    uint64_t                                   mRescored      = 0;  // edge errors recomputed after collapses
+    uint64_t                                   mFallbacks     = 0;  // of mRescored, optimal placement not solved
+    uint64_t                                   mInitFallbacks = 0;  // same over the edges of Init
+    std::size_t                                mHeapPeak      = 0;
+    std::vector<LoopSample>                    mTimeline;
+
+    inline uint64_t Count(const CollapseCheck check) const { return mChecks[static_cast<std::size_t>(check)]; }
+    inline uint64_t Rejected() const { return mPops - Count(CollapseCheck::Ok); }
+    inline uint64_t Stale() const { return Count(CollapseCheck::DeletedEdge) + Count(CollapseCheck::DeletedVertex); }
+
+    inline void Pop(const CollapseCheck check)
+    {
+        ++mPops;
+        ++mChecks[static_cast<std::size_t>(check)];
+    }
+};
+
+#endif // !LOOP_STATS_H
@@ -4,26 +4,58 @@
 #include <OpenMesh/Core/IO/MeshIO.hh>
 #include <OpenMesh/Core/Mesh/TriMesh_ArrayKernelT.hh>
 #include <Eigen/Dense>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "heap.h"
+#include "loop_stats.h"
+#include "quadric.h"
+#include "quadric_batch.h"
 
 struct Traits : public OpenMesh::DefaultTraits {
     VertexTraits { 
-        Eigen::Matrix4d Quadric; 
+        SymQuadric Quadric; 
     };
 
     EdgeTraits { 
-        double Error;
-        Eigen::Vector4d NewVertex;
+        QuadricScalar Error;
+        OpenMesh::Vec3f NewVertex;
+    };
+
+    FaceTraits {
+        SymQuadric Quadric;
     };
 };
 
 using Mesh = OpenMesh::TriMesh_ArrayKernelT<Traits>;
+using EdgeHeap = IndexedHeap<QuadricScalar, 4>;
 
 inline bool CompareMeshEdge(const Mesh& mesh, const Mesh::EdgeHandle& e1, const Mesh::EdgeHandle& e2) {
     return mesh.data(e1).Error > mesh.data(e2).Error;
 };
 
-inline Eigen::Vector4d EvaluateFacePlane(Mesh& mesh, 
-                                         const OpenMesh::FaceHandle fh) 
+inline SymQuadric::Vector4 EvaluateFacePlane(const Eigen::Vector3f& p0,
+                                             const Eigen::Vector3f& p1,
+                                             const Eigen::Vector3f& p2)
+{
+    Eigen::Vector3f u = p1 - p0;
+    Eigen::Vector3f v = p2 - p0;
+    Eigen::Vector3f n = u.cross(v);
+    n.normalize();
+
+    float a = n.x();
+    float b = n.y();
+    float c = n.z();
+    float d = -n.dot(p0);
+
+    return SymQuadric::Vector4(a, b, c, d);
+}
+
+inline SymQuadric::Vector4 EvaluateFacePlane(Mesh& mesh, 
+                                             const OpenMesh::FaceHandle fh) 
 {
 
     std::array<Eigen::Vector3f, 3> points;
@@ -33,69 +65,339 @@ inline Eigen::Vector4d EvaluateFacePlane(Mesh& mesh,
         points[i++] = Eigen::Vector3f(p[0], p[1], p[2]);
     }
 
-    Eigen::Vector3f u = points[1] - points[0];
-    Eigen::Vector3f v = points[2] - points[0];
-    Eigen::Vector3f n = u.cross(v);
-    n.normalize();
-
-    float a = n.x();
-    float b = n.y();
-    float c = n.z();
-    float d = -n.dot(points[0]);
+    return EvaluateFacePlane(points[0], points[1], points[2]);
+}
 
-    return Eigen::Vector4d(a, b, c, d);
+inline SymQuadric EvaluateFacePlaneMatrix(Mesh& mesh, 
+                                          const OpenMesh::FaceHandle fh)
+{
+    return SymQuadric::FromPlane(EvaluateFacePlane(mesh, fh));
 }
 
-inline Eigen::Matrix4d EvaluateFacePlaneMatrix(Mesh& mesh, 
-                                               const OpenMesh::FaceHandle fh)
+// Refresh the cached plane quadric of a face, must be called every time 
+// one of its vertices is moved.
+inline void UpdateFaceQuadric(Mesh& mesh, const OpenMesh::FaceHandle fh)
 {
-    Eigen::Vector4d planeCoeficient = EvaluateFacePlane(mesh, fh);
-    return planeCoeficient * planeCoeficient.transpose();
+    mesh.data(fh).Quadric = EvaluateFacePlaneMatrix(mesh, fh);
 }
 
-inline Eigen::Matrix4d EvaluateVertexQuadratic(Mesh& mesh, 
-                                               const OpenMesh::VertexHandle vh)
+// Sum of the cached face quadrics, so face quadrics of the 1-ring have to be 
+// up to date (see UpdateFaceQuadric).
+inline SymQuadric EvaluateVertexQuadratic(Mesh& mesh, 
+                                          const OpenMesh::VertexHandle vh)
 {
-    Eigen::Matrix4d result = Eigen::Matrix4d::Zero();
+    SymQuadric result;
     for (auto f_it = mesh.vf_iter(vh); f_it.is_valid(); ++f_it) {
         auto fh = *f_it; 
-        result += EvaluateFacePlaneMatrix(mesh, fh);        
+        result += mesh.data(fh).Quadric;
     }
 
     return result;
 }
 
-inline Eigen::Vector4d EvaluateNewBestVertex(const Mesh& mesh, 
-                                             const OpenMesh::EdgeHandle eh, 
-                                             const Eigen::Matrix4d Q) 
+// New vertex of an edge under placement policy P (see Placement). Optimal
+// solves the quadric when it is invertible, otherwise takes the best of the
+// endpoints and the midpoint and sets fellBack.
+template <Placement P>
+inline SymQuadric::Vector3 EvaluateNewBestVertex(const SymQuadric::Vector3& p1,
+                                                 const SymQuadric::Vector3& p2,
+                                                 const SymQuadric& Q,
+                                                 bool* fellBack = nullptr)
+{
+    SymQuadric::Vector3 mid = QuadricScalar(0.5) * (p1 + p2);
+    if constexpr (P == Placement::Midpoint)
+        return mid;
+
+    if constexpr (P == Placement::Optimal) {
+        SymQuadric::Vector3 best;
+        if (Q.Solve(best))
+            return best;
+        if (fellBack) *fellBack = true;
+    }
+
+    QuadricScalar e1 = Q.Evaluate(p1);
+    QuadricScalar e2 = Q.Evaluate(p2);
+    if constexpr (P == Placement::Endpoints)
+        return e1 <= e2 ? p1 : p2;
+
+    QuadricScalar em = Q.Evaluate(mid);
+
+    if (e1 <= e2 && e1 <= em)       return p1;
+    else if (e2 <= e1 && e2 <= em)  return p2;
+    else                            return mid;
+}
+
+template <Placement P>
+inline SymQuadric::Vector3 EvaluateNewBestVertex(const Mesh& mesh, 
+                                                 const OpenMesh::EdgeHandle eh, 
+                                                 const SymQuadric& Q,
+                                                 bool* fellBack = nullptr) 
 {   
-    Eigen::Matrix4d quadric;
-    quadric << Q(0,0), Q(0,1), Q(0,2), Q(0,3),
-               Q(0,1), Q(1,1), Q(1,2), Q(1,3),
-               Q(0,2), Q(1,2), Q(2,2), Q(2,3),
-               0.0f,   0.0f,   0.0f,   1.0f;
-
-    auto Error = [&](const Eigen::Vector4d& p) { return p.transpose() * Q * p; };
-
-    if (fabs(quadric.determinant()) > 1e-12)
-        return quadric.inverse() * Eigen::Vector4d(0, 0, 0, 1);
-   
-    else {
-        auto heh = mesh.halfedge_handle(eh, 0);
-        auto vh1 = mesh.from_vertex_handle(heh);
-        auto vh2 = mesh.to_vertex_handle(heh);
-        Eigen::Vector4d p1(mesh.point(vh1)[0], mesh.point(vh1)[1], mesh.point(vh1)[2], 1.f);
-        Eigen::Vector4d p2(mesh.point(vh2)[0], mesh.point(vh2)[1], mesh.point(vh2)[2], 1.f);
-        Eigen::Vector4d mid = 0.5 * (p1 + p2);
-
-        double e1 = Error(p1);
-        double e2 = Error(p2);
-        double em = Error(mid);
-
-        if (e1 <= e2 && e1 <= em)       return p1;
-        else if (e2 <= e1 && e2 <= em)  return p2;
-        else                            return mid;
+    auto heh = mesh.halfedge_handle(eh, 0);
+    auto vh1 = mesh.from_vertex_handle(heh);
+    auto vh2 = mesh.to_vertex_handle(heh);
+    SymQuadric::Vector3 p1(mesh.point(vh1)[0], mesh.point(vh1)[1], mesh.point(vh1)[2]);
+    SymQuadric::Vector3 p2(mesh.point(vh2)[0], mesh.point(vh2)[1], mesh.point(vh2)[2]);
+    return EvaluateNewBestVertex<P>(p1, p2, Q, fellBack);
+}
+
+// Edges of the triangles incident to heh, a superset of the edges that 
+// mesh.collapse(heh) deletes. Boundary sides are left invalid.
+inline std::array<OpenMesh::EdgeHandle, 6> CollapsedFaceEdges(const Mesh& mesh, 
+                                                              const OpenMesh::HalfedgeHandle heh)
+{
+    std::array<OpenMesh::EdgeHandle, 6> edges;
+    int i = 0;
+    for (auto h : {heh, mesh.opposite_halfedge_handle(heh)}) {
+        auto fh = mesh.face_handle(h);
+        if (!fh.is_valid()) { i += 3; continue; }
+        for (auto fe_it = mesh.fe_iter(fh); fe_it.is_valid(); ++fe_it)
+            edges[i++] = *fe_it;
+    }
+    return edges;
+}
+
+// Returns 1 when the optimal placement fell back, 0 otherwise
+template <Placement P>
+inline uint32_t UpdateEdgeError(Mesh& mesh, const OpenMesh::EdgeHandle eh)
+{
+    auto heh = mesh.halfedge_handle(eh, 0);
+    auto v0 = mesh.from_vertex_handle(heh);
+    auto v1 = mesh.to_vertex_handle(heh);
+
+    SymQuadric Q = mesh.data(v0).Quadric + mesh.data(v1).Quadric;
+    bool fellBack = false;
+    SymQuadric::Vector3 newV = EvaluateNewBestVertex<P>(mesh, eh, Q, &fellBack);
+
+    mesh.data(eh).Error = Q.Evaluate(newV);
+    mesh.data(eh).NewVertex = OpenMesh::Vec3f(newV.x(), newV.y(), newV.z());
+    return fellBack;
+}
+
+// Index based kernel interface, FlatMesh (flat_mesh.h) provides the same
+// functions so the simplification code can be templated on the kernel.
+// Edges are collapsed from the from-vertex of their first halfedge into its
+// to-vertex. The edge error functions take the placement policy as their
+// first template argument and return how many edges fell back from the
+// optimal placement.
+
+constexpr uint32_t InvalidIndex = 0xFFFFFFFFu;
+
+inline std::size_t NumVertices(const Mesh& mesh) { return mesh.n_vertices(); }
+inline std::size_t NumEdges(const Mesh& mesh)    { return mesh.n_edges(); }
+inline std::size_t NumFaces(const Mesh& mesh)    { return mesh.n_faces(); }
+
+// Status bits are needed by collapse and garbage collection
+inline void PrepareMesh(Mesh& mesh)
+{
+    mesh.request_vertex_status();
+    mesh.request_edge_status();
+    mesh.request_face_status();
+    mesh.request_halfedge_status();
+}
+
+inline void UpdateFaceQuadric(Mesh& mesh, const uint32_t f)
+{
+    UpdateFaceQuadric(mesh, Mesh::FaceHandle(f));
+}
+
+// Face quadrics of the faces [begin, end) through the batched kernel
+inline void UpdateFaceQuadrics(Mesh& mesh, const uint32_t begin, const uint32_t end)
+{
+    FaceBlock block;
+    SymQuadric quadrics[QUADRIC_BLOCK];
+
+    for (uint32_t first = begin; first < end; first += QUADRIC_BLOCK) {
+        const uint32_t count = std::min(end - first, QUADRIC_BLOCK);
+        for (uint32_t i = 0; i < count; ++i) {
+            auto heh = mesh.halfedge_handle(Mesh::FaceHandle(first + i));
+            for (int k = 0; k < 3; ++k) {
+                const auto& p = mesh.point(mesh.to_vertex_handle(heh));
+                block.mX[k][i] = p[0];
+                block.mY[k][i] = p[1];
+                block.mZ[k][i] = p[2];
+                heh = mesh.next_halfedge_handle(heh);
+            }
+        }
+
+        ComputeFaceQuadrics(block, count, quadrics);
+        for (uint32_t i = 0; i < count; ++i)
+            mesh.data(Mesh::FaceHandle(first + i)).Quadric = quadrics[i];
+    }
+}
+
+inline void UpdateVertexQuadric(Mesh& mesh, const uint32_t v)
+{
+    const auto vh = Mesh::VertexHandle(v);
+    mesh.data(vh).Quadric = EvaluateVertexQuadratic(mesh, vh);
+}
+
+template <Placement P>
+inline uint32_t UpdateEdgeError(Mesh& mesh, const uint32_t e)
+{
+    return UpdateEdgeError<P>(mesh, Mesh::EdgeHandle(e));
+}
+
+// Batched UpdateEdgeError over count edges, edgeAt(i) is the i-th edge
+template <Placement P, typename EdgeAt>
+inline uint32_t UpdateEdgeErrorBlocks(Mesh& mesh, const std::size_t count, EdgeAt edgeAt)
+{
+    EdgeBlock block;
+    EdgeSolution solution;
+    uint32_t fallbacks = 0;
+
+    for (std::size_t first = 0; first < count; first += QUADRIC_BLOCK) {
+        const uint32_t n = std::min<std::size_t>(count - first, QUADRIC_BLOCK);
+        for (uint32_t i = 0; i < n; ++i) {
+            auto heh = mesh.halfedge_handle(Mesh::EdgeHandle(edgeAt(first + i)), 0);
+            const Mesh::VertexHandle ends[2] = {mesh.from_vertex_handle(heh), mesh.to_vertex_handle(heh)};
+            const SymQuadric& q0 = mesh.data(ends[0]).Quadric;
+            const SymQuadric& q1 = mesh.data(ends[1]).Quadric;
+            for (int j = 0; j < 10; ++j) block.mQ[j][i] = q0.m[j] + q1.m[j];
+            for (int k = 0; k < 2; ++k) {
+                const auto& p = mesh.point(ends[k]);
+                for (int d = 0; d < 3; ++d) block.mP[k][d][i] = p[d];
+            }
+        }
+
+        fallbacks += SolveEdgeQuadrics<P>(block, n, solution);
+        for (uint32_t i = 0; i < n; ++i) {
+            auto& data = mesh.data(Mesh::EdgeHandle(edgeAt(first + i)));
+            data.Error = solution.mError[i];
+            data.NewVertex = OpenMesh::Vec3f(solution.mX[i], solution.mY[i], solution.mZ[i]);
+        }
+    }
+    return fallbacks;
+}
+
+template <Placement P>
+inline uint32_t UpdateEdgeErrors(Mesh& mesh, const uint32_t begin, const uint32_t end)
+{
+    return UpdateEdgeErrorBlocks<P>(mesh, end - begin, [&](std::size_t i) { return uint32_t(begin + i); });
+}
+
+template <Placement P>
+inline uint32_t UpdateEdgeErrors(Mesh& mesh, std::span<const uint32_t> edges)
+{
+    return UpdateEdgeErrorBlocks<P>(mesh, edges.size(), [&](std::size_t i) { return edges[i]; });
+}
+
+inline QuadricScalar EdgeError(const Mesh& mesh, const uint32_t e)
+{
+    return mesh.data(Mesh::EdgeHandle(e)).Error;
+}
+
+inline std::array<uint32_t, 2> EdgeVertices(const Mesh& mesh, const uint32_t e)
+{
+    auto heh = mesh.halfedge_handle(Mesh::EdgeHandle(e), 0);
+    return {static_cast<uint32_t>(mesh.from_vertex_handle(heh).idx()),
+            static_cast<uint32_t>(mesh.to_vertex_handle(heh).idx())};
+}
+
+inline bool IsBoundaryEdge(const Mesh& mesh, const uint32_t e)
+{
+    return mesh.is_boundary(Mesh::EdgeHandle(e));
+}
+
+inline bool IsEdgeLocked(const Mesh& mesh, const uint32_t e)
+{
+    auto [v0, v1] = EdgeVertices(mesh, e);
+    return mesh.status(Mesh::VertexHandle(v0)).locked() ||
+           mesh.status(Mesh::VertexHandle(v1)).locked();
+}
+
+inline CollapseCheck CheckCollapseEdge(Mesh& mesh, const uint32_t e)
+{
+    auto eh = Mesh::EdgeHandle(e);
+    if (mesh.status(eh).deleted())
+        return CollapseCheck::DeletedEdge;
+
+    auto heh = mesh.halfedge_handle(eh, 0);
+    auto vh0 = mesh.from_vertex_handle(heh);
+    auto vh1 = mesh.to_vertex_handle(heh);
+    if (mesh.status(vh0).deleted() || mesh.status(vh1).deleted())
+        return CollapseCheck::DeletedVertex;
+
+    if (!mesh.is_collapse_ok(heh))
+        return CollapseCheck::Topology;
+
+    if (mesh.status(vh0).locked() || mesh.status(vh1).locked())
+        return CollapseCheck::Locked;
+
+    return CollapseCheck::Ok;
+}
+
+inline bool CanCollapseEdge(Mesh& mesh, const uint32_t e)
+{
+    return CheckCollapseEdge(mesh, e) == CollapseCheck::Ok;
+}
+
+// Moves the to-vertex to the edge optimum, accumulates the quadric and
+// collapses. Deleted edges are appended to removed, returns the survivor.
+inline uint32_t CollapseEdge(Mesh& mesh, const uint32_t e, std::vector<uint32_t>& removed)
+{
+    auto eh = Mesh::EdgeHandle(e);
+    auto heh = mesh.halfedge_handle(eh, 0);
+    auto vh0 = mesh.from_vertex_handle(heh);
+    auto vh1 = mesh.to_vertex_handle(heh);
+
+    mesh.set_point(vh1, mesh.data(eh).NewVertex);
+    mesh.data(vh1).Quadric += mesh.data(vh0).Quadric;
+
+    auto collapsedEdges = CollapsedFaceEdges(mesh, heh);
+    mesh.collapse(heh);
+
+    for (auto ehd : collapsedEdges) {
+        if (ehd.is_valid() && mesh.status(ehd).deleted())
+            removed.push_back(ehd.idx());
     }
+    return vh1.idx();
+}
+
+// Edges to re-score after a collapse into v. Accumulate mode only takes the
+// edges of v, otherwise the face and vertex quadrics around v are refreshed
+// first and the edges of the faces around v are taken.
+inline void CollectDirtyEdges(Mesh& mesh, const uint32_t v, const bool accumulate,
+                              std::vector<uint32_t>& dirty)
+{
+    const auto vh = Mesh::VertexHandle(v);
+    if (accumulate) {
+        for (auto ve_it = mesh.ve_iter(vh); ve_it.is_valid(); ++ve_it) {
+            if (!mesh.status(*ve_it).deleted()) dirty.push_back((*ve_it).idx());
+        }
+        return;
+    }
+
+    for (auto vf_it = mesh.vf_iter(vh); vf_it.is_valid(); ++vf_it) {
+        if (!mesh.status(*vf_it).deleted()) UpdateFaceQuadric(mesh, *vf_it);
+    }
+
+    for (auto vf_it = mesh.vf_iter(vh); vf_it.is_valid(); ++vf_it) {
+        auto fh = *vf_it;
+        if (mesh.status(fh).deleted()) continue;
+
+        for (auto fv_it = mesh.fv_iter(fh); fv_it.is_valid(); ++fv_it) {
+            auto vr = *fv_it;
+            if (mesh.status(vr).deleted()) continue;
+            mesh.data(vr).Quadric = EvaluateVertexQuadratic(mesh, vr);
+        }
+
+        for (auto fe_it = mesh.fe_iter(fh); fe_it.is_valid(); ++fe_it) {
+            if (!mesh.status(*fe_it).deleted()) dirty.push_back((*fe_it).idx());
+        }
+    }
+}
+
+template <typename Fn>
+inline void ForEachVertexVertex(const Mesh& mesh, const uint32_t v, Fn fn)
+{
+    for (auto vv_it = mesh.cvv_iter(Mesh::VertexHandle(v)); vv_it.is_valid(); ++vv_it)
+        fn(static_cast<uint32_t>((*vv_it).idx()));
+}
+
+inline void CompactMesh(Mesh& mesh)
+{
+    mesh.garbage_collection();
 }
 
 #endif
@@ -0,0 +1,380 @@
+#ifndef MESH_IO_H
+#define MESH_IO_H
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <future>
+#include <omp.h>
+#include <string>
+#include <vector>
+
+#include "binary_mesh.h"
+#include "flat_mesh.h"
+#include "logging.h"
+#include "mesh.h"
+#include "mesh_writer.h"
+#include "obj_stream.h"
+
+// Indexed triangle arrays of a mesh, deleted elements are skipped
+inline void FlattenMesh(const Mesh& mesh, std::vector<float>& positions, std::vector<uint32_t>& indices)
+{
+    const std::size_t nVertices = mesh.n_vertices(), nFaces = mesh.n_faces();
+    std::vector<uint32_t> remap(nVertices, BINARY_MESH_NO_CORNER), faces;
+    faces.reserve(nFaces);
+
+    uint32_t next = 0;
+    for (std::size_t v = 0; v < nVertices; ++v) {
+        if (mesh.has_vertex_status() && mesh.status(Mesh::VertexHandle(v)).deleted()) continue;
+        remap[v] = next++;
+    }
+    for (std::size_t f = 0; f < nFaces; ++f) {
+        if (mesh.has_face_status() && mesh.status(Mesh::FaceHandle(f)).deleted()) continue;
+        faces.push_back(f);
+    }
+
+    positions.resize(3 * std::size_t(next));
+    indices.resize(3 * faces.size());
+
+    #pragma omp parallel for
+    for (int64_t v = 0; v < int64_t(nVertices); ++v) {
+        if (remap[v] == BINARY_MESH_NO_CORNER) continue;
+        const auto& p = mesh.point(Mesh::VertexHandle(v));
+        for (int k = 0; k < 3; ++k) positions[3 * std::size_t(remap[v]) + k] = float(p[k]);
+    }
+
+    #pragma omp parallel for
+    for (int64_t i = 0; i < int64_t(faces.size()); ++i) {
+        int k = 0;
+        for (auto fv_it = mesh.cfv_iter(Mesh::FaceHandle(faces[i])); fv_it.is_valid(); ++fv_it)
+            indices[3 * i + k++] = remap[(*fv_it).idx()];
+    }
+}
+
+inline void FlattenMesh(const FlatMesh& mesh, std::vector<float>& positions, std::vector<uint32_t>& indices)
+{
+    mesh.Flatten(positions, indices);
+}
+
+// Parallel half-edge construction from the opposite corner table. The face
+// halfedge of corner c runs along the edge opposite to c and edge e owns the
+// halfedges 2e and 2e + 1, the odd one being the boundary halfedge when the
+// edge has a single face. Returns false, without touching the mesh, when the
+// input is not a manifold OpenMesh can represent.
+inline bool BuildMeshConnectivity(Mesh& mesh,
+                                  const float* positions, const std::size_t nVertices,
+                                  const uint32_t* indices, const std::size_t nFaces,
+                                  const uint32_t* opposites = nullptr)
+{
+    constexpr uint32_t NONE = BINARY_MESH_NO_CORNER;
+    const std::size_t nCorners = 3 * nFaces;
+    if (nCorners >= std::size_t(INT_MAX) || nVertices >= std::size_t(INT_MAX)) return false;
+
+    bool valid = true;
+    #pragma omp parallel for reduction(&&: valid)
+    for (int64_t f = 0; f < int64_t(nFaces); ++f) {
+        const uint32_t* v = indices + 3 * f;
+        valid = valid && v[0] < nVertices && v[1] < nVertices && v[2] < nVertices &&
+                v[0] != v[1] && v[1] != v[2] && v[0] != v[2];
+    }
+    if (!valid) return false;
+
+    std::vector<uint32_t> computed;
+    if (!opposites) {
+        computed = ComputeOppositeCorners(indices, nFaces, nVertices);
+        opposites = computed.data();
+    }
+
+    #pragma omp parallel for reduction(&&: valid)
+    for (int64_t c = 0; c < int64_t(nCorners); ++c) {
+        const uint32_t o = opposites[c];
+        valid = valid && (o == NONE || (o < nCorners && opposites[o] == uint32_t(c)));
+    }
+    if (!valid) return false;
+
+    // Edge ids follow the owning corner order, the lower corner of a pair owns it
+    auto owns = [&](std::size_t c) { return opposites[c] == NONE || opposites[c] > c; };
+
+    const std::size_t nBlocks = std::max(1, omp_get_max_threads());
+    auto blockBegin = [&](std::size_t b) { return nCorners * b / nBlocks; };
+    std::vector<std::size_t> blockEdges(nBlocks + 1, 0);
+    std::vector<uint32_t> halfedgeOf(nCorners);
+
+    #pragma omp parallel for schedule(static, 1)
+    for (std::size_t b = 0; b < nBlocks; ++b) {
+        std::size_t count = 0;
+        for (std::size_t c = blockBegin(b); c < blockBegin(b + 1); ++c) count += owns(c);
+        blockEdges[b + 1] = count;
+    }
+    for (std::size_t b = 0; b < nBlocks; ++b) blockEdges[b + 1] += blockEdges[b];
+
+    const std::size_t nEdges = blockEdges[nBlocks];
+    const std::size_t nHalfedges = 2 * nEdges;
+    if (nHalfedges >= std::size_t(INT_MAX)) return false;
+
+    #pragma omp parallel for schedule(static, 1)
+    for (std::size_t b = 0; b < nBlocks; ++b) {
+        uint32_t e = blockEdges[b];
+        for (std::size_t c = blockBegin(b); c < blockBegin(b + 1); ++c)
+            if (owns(c)) halfedgeOf[c] = 2 * e++;
+    }
+
+    #pragma omp parallel for
+    for (int64_t c = 0; c < int64_t(nCorners); ++c)
+        if (!owns(c)) halfedgeOf[c] = halfedgeOf[opposites[c]] + 1;
+
+    std::vector<uint32_t> to(nHalfedges), next(nHalfedges), faceOf(nHalfedges, NONE);
+    std::vector<uint32_t> boundaryOut(nVertices, NONE), anyOut(nVertices, NONE), valence(nVertices, 0);
+
+    #pragma omp parallel for reduction(&&: valid)
+    for (int64_t c = 0; c < int64_t(nCorners); ++c) {
+        const std::size_t f = c / 3, k = c % 3;
+        const uint32_t from = indices[3 * f + (k + 1) % 3];
+        const uint32_t dest = indices[3 * f + (k + 2) % 3];
+        const uint32_t h = halfedgeOf[c];
+
+        to[h]     = dest;
+        next[h]   = halfedgeOf[3 * f + (k + 1) % 3];
+        faceOf[h] = f;
+
+        std::atomic_ref<uint32_t>(valence[indices[c]]).fetch_add(1, std::memory_order_relaxed);
+
+        // Lowest outgoing halfedge, keeps the result independent of scheduling
+        std::atomic_ref<uint32_t> out(anyOut[from]);
+        uint32_t current = out.load(std::memory_order_relaxed);
+        while (h < current && !out.compare_exchange_weak(current, h, std::memory_order_relaxed));
+
+        if (opposites[c] == NONE) {
+            // A manifold vertex has at most one outgoing boundary halfedge
+            to[h + 1] = from;
+            uint32_t expected = NONE;
+            valid = valid && std::atomic_ref<uint32_t>(boundaryOut[dest]).compare_exchange_strong(
+                expected, h + 1, std::memory_order_relaxed);
+        }
+    }
+    if (!valid) return false;
+
+    #pragma omp parallel for reduction(&&: valid)
+    for (int64_t h = 1; h < int64_t(nHalfedges); h += 2) {
+        if (faceOf[h] != NONE) continue;
+        next[h] = boundaryOut[to[h]];
+        valid = valid && next[h] != NONE;
+    }
+    if (!valid) return false;
+
+    // Rotating around a vertex must reach all its faces, otherwise it joins
+    // several fans.
+    #pragma omp parallel for schedule(dynamic, 1024) reduction(&&: valid)
+    for (int64_t v = 0; v < int64_t(nVertices); ++v) {
+        const uint32_t start = boundaryOut[v] != NONE ? boundaryOut[v] : anyOut[v];
+        if (start == NONE) continue;
+
+        uint32_t h = start, visited = 0, steps = 0;
+        do {
+            visited += faceOf[h] != NONE;
+            h = next[h ^ 1];
+        } while (h != start && ++steps <= valence[v]);
+        valid = valid && visited == valence[v];
+    }
+    if (!valid) return false;
+
+    mesh.clear();
+    mesh.resize(nVertices, nEdges, nFaces);
+
+    #pragma omp parallel for
+    for (int64_t v = 0; v < int64_t(nVertices); ++v) {
+        const Mesh::VertexHandle vh(v);
+        const float* p = positions + 3 * v;
+        mesh.set_point(vh, Mesh::Point(p[0], p[1], p[2]));
+
+        const uint32_t out = boundaryOut[v] != NONE ? boundaryOut[v] : anyOut[v];
+        if (out != NONE) mesh.set_halfedge_handle(vh, Mesh::HalfedgeHandle(out));
+    }
+
+    #pragma omp parallel for
+    for (int64_t h = 0; h < int64_t(nHalfedges); ++h) {
+        const Mesh::HalfedgeHandle hh(h);
+        mesh.set_vertex_handle(hh, Mesh::VertexHandle(to[h]));
+        mesh.set_next_halfedge_handle(hh, Mesh::HalfedgeHandle(next[h]));
+        if (faceOf[h] != NONE) mesh.set_face_handle(hh, Mesh::FaceHandle(faceOf[h]));
+    }
+
+    #pragma omp parallel for
+    for (int64_t f = 0; f < int64_t(nFaces); ++f)
+        mesh.set_halfedge_handle(Mesh::FaceHandle(f), Mesh::HalfedgeHandle(halfedgeOf[3 * f]));
+
+    return true;
+}
+
+// Builds the mesh from indexed triangle arrays. Non-manifold inputs go
+// through add_face, which skips the faces it rejects.
+inline void BuildMeshFromArrays(Mesh& mesh,
+                                const float* positions, const std::size_t nVertices,
+                                const uint32_t* indices, const std::size_t nFaces,
+                                const uint32_t* opposites = nullptr)
+{
+    if (BuildMeshConnectivity(mesh, positions, nVertices, indices, nFaces, opposites)) return;
+    LOG_WARN("Non-manifold input, building the mesh face by face");
+
+    mesh.clear();
+    mesh.reserve(nVertices, nFaces * 3 / 2, nFaces);
+
+    for (std::size_t v = 0; v < nVertices; ++v) {
+        const float* p = positions + 3 * v;
+        mesh.add_vertex(Mesh::Point(p[0], p[1], p[2]));
+    }
+
+    std::size_t skipped = 0;
+    for (std::size_t f = 0; f < nFaces; ++f) {
+        const uint32_t* face = indices + 3 * f;
+        if (face[0] >= nVertices || face[1] >= nVertices || face[2] >= nVertices) {
+            ++skipped;
+            continue;
+        }
+        auto fh = mesh.add_face(Mesh::VertexHandle(face[0]),
+                                Mesh::VertexHandle(face[1]),
+                                Mesh::VertexHandle(face[2]));
+        if (!fh.is_valid()) ++skipped;
+    }
+
+    if (skipped) LOG_WARN("%zu non-manifold faces skipped while building the mesh", skipped);
+}
+
+inline void BuildMeshFromArrays(FlatMesh& mesh,
+                                const float* positions, const std::size_t nVertices,
+                                const uint32_t* indices, const std::size_t nFaces,
+                                const uint32_t* opposites = nullptr)
+{
+    mesh.Build(positions, nVertices, indices, nFaces, opposites);
+}
+
+inline bool ReadObjMesh(Mesh& mesh, const std::string& path)
+{
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    if (!ReadObjParallel(path, positions, indices)) return false;
+
+    BuildMeshFromArrays(mesh, positions.data(), positions.size() / 3,
+                        indices.data(), indices.size() / 3);
+    return true;
+}
+
+inline bool ReadBinaryMesh(Mesh& mesh, const std::string& path)
+{
+    MappedBinaryMesh binary;
+    if (!binary.Open(path)) return false;
+
+    BuildMeshFromArrays(mesh, binary.Positions(), binary.NumVertices(),
+                        binary.Indices(), binary.NumFaces(), binary.Opposites());
+    return true;
+}
+
+inline bool WriteBinaryMesh(const Mesh& mesh, const std::string& path, const bool adjacency = false)
+{
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    FlattenMesh(mesh, positions, indices);
+    return WriteBinaryMesh(path, positions.data(), positions.size() / 3,
+                           indices.data(), indices.size() / 3, adjacency);
+}
+
+inline bool IsObjPath(const std::string& path)
+{
+    return path.size() >= 4 && path.compare(path.size() - 4, 4, ".obj") == 0;
+}
+
+// Mesh import, .bmesh files go through the binary format, OBJ through the
+// parallel reader and anything else through OpenMesh.
+inline bool ReadMesh(Mesh& mesh, const std::string& path)
+{
+    if (IsBinaryMeshPath(path)) return ReadBinaryMesh(mesh, path);
+    if (IsObjPath(path)) {
+        if (ReadObjMesh(mesh, path)) return true;
+        LOG_WARN("Parallel OBJ import of %s failed, falling back to the OpenMesh reader", path.c_str());
+    }
+    return OpenMesh::IO::read_mesh(mesh, path);
+}
+
+inline bool ReadMesh(FlatMesh& mesh, const std::string& path)
+{
+    if (IsBinaryMeshPath(path)) {
+        MappedBinaryMesh binary;
+        if (!binary.Open(path)) return false;
+        mesh.Build(binary.Positions(), binary.NumVertices(),
+                   binary.Indices(), binary.NumFaces(), binary.Opposites());
+        return true;
+    }
+
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    if (!IsObjPath(path) || !ReadObjParallel(path, positions, indices)) {
+        Mesh source;
+        if (!OpenMesh::IO::read_mesh(source, path)) return false;
+        FlattenMesh(source, positions, indices);
+    }
+
+    mesh.Build(positions.data(), positions.size() / 3, indices.data(), indices.size() / 3);
+    return true;
+}
+
+// Formats the parallel writer does not handle (.off, .stl, ...)
+inline bool WriteMeshOpenMesh(const Mesh& mesh, const std::string& path, const bool binary)
+{
+    OpenMesh::IO::Options options;
+    if (binary) options += OpenMesh::IO::Options::Binary;
+    return OpenMesh::IO::write_mesh(mesh, path, options);
+}
+
+// Background export of indexed triangle arrays, MeshFormat::Other rebuilds
+// a Mesh in the job for OpenMesh.
+inline std::future<bool> ExportMeshAsync(const std::string& path,
+                                         std::vector<float>&& positions,
+                                         std::vector<uint32_t>&& indices,
+                                         const bool binary)
+{
+    const MeshFormat format = MeshFormatOf(path, binary);
+    if (format != MeshFormat::Other)
+        return ExportMeshAsync(path, std::move(positions), std::move(indices), format);
+
+    return std::async(std::launch::async,
+        [path, binary, positions = std::move(positions), indices = std::move(indices)]() {
+            Mesh mesh;
+            BuildMeshFromArrays(mesh, positions.data(), positions.size() / 3, indices.data(), indices.size() / 3);
+            return WriteMeshOpenMesh(mesh, path, binary);
+        });
+}
+
+// Export goes through the parallel writer when it handles the extension
+// (.obj, .ply, .bmesh), through OpenMesh otherwise. binary selects binary
+// PLY, or the binary variant of the OpenMesh format.
+inline bool WriteMesh(const Mesh& mesh, const std::string& path, const bool binary = false)
+{
+    if (MeshFormatOf(path, binary) == MeshFormat::Other)
+        return WriteMeshOpenMesh(mesh, path, binary);
+
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    FlattenMesh(mesh, positions, indices);
+    return ExportMesh(path, positions.data(), positions.size() / 3,
+                      indices.data(), indices.size() / 3, MeshFormatOf(path, binary));
+}
+
+// Flattens the mesh and exports it in the background, the mesh can be
+// modified or released as soon as this returns.
+inline std::future<bool> WriteMeshAsync(const Mesh& mesh, const std::string& path, const bool binary = false)
+{
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    FlattenMesh(mesh, positions, indices);
+    return ExportMeshAsync(path, std::move(positions), std::move(indices), binary);
+}
+
+inline std::future<bool> WriteMeshAsync(const FlatMesh& mesh, const std::string& path, const bool binary = false)
+{
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    mesh.Flatten(positions, indices);
+    return ExportMeshAsync(path, std::move(positions), std::move(indices), binary);
+}
+
+#endif // !MESH_IO_H
@@ -0,0 +1,169 @@
+#ifndef MESH_WRITER_H
+#define MESH_WRITER_H
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <omp.h>
+#include <string>
+#include <vector>
+
+#include "binary_mesh.h"
+
+// Parallel exporter over indexed triangle arrays. Records are formatted by
+// blocks into per-thread buffers and every batch of blocks is written in
+// order with large sequential writes.
+
+// Other is any extension the writer does not handle (.off, .stl, ...),
+// mesh_io.h hands those to OpenMesh and ExportMesh fails on them.
+enum class MeshFormat { Obj, PlyAscii, PlyBinary, Binary, Other };
+
+inline MeshFormat MeshFormatOf(const std::string& path, const bool binary = false)
+{
+    auto endsWith = [&](const char* ext) {
+        const std::size_t n = std::strlen(ext);
+        return path.size() >= n && path.compare(path.size() - n, n, ext) == 0;
+    };
+    if (endsWith(".bmesh")) return MeshFormat::Binary;
+    if (endsWith(".ply")) return binary ? MeshFormat::PlyBinary : MeshFormat::PlyAscii;
+    if (endsWith(".obj")) return MeshFormat::Obj;
+    return MeshFormat::Other;
+}
+
+class MeshWriter {
+    static constexpr std::size_t BLOCK_RECORDS = 1 << 16;
+
+    FILE* mFile;
+    bool  mOk = true;
+
+public:
+    explicit MeshWriter(FILE* file) : mFile(file) {}
+
+    inline bool Ok() const { return mOk; }
+
+    inline void Write(const void* data, const std::size_t bytes)
+    {
+        mOk = mOk && std::fwrite(data, 1, bytes, mFile) == bytes;
+    }
+
+    // format(i, std::string& out) appends record i, blocks are written in order
+    template <typename FormatFn>
+    void Records(const std::size_t count, FormatFn format)
+    {
+        const std::size_t nBlocks = (count + BLOCK_RECORDS - 1) / BLOCK_RECORDS;
+        const std::size_t batch = std::max(1, omp_get_max_threads());
+        std::vector<std::string> buffers(batch);
+
+        for (std::size_t first = 0; first < nBlocks; first += batch) {
+            const std::size_t last = std::min(nBlocks, first + batch);
+
+            #pragma omp parallel for schedule(dynamic, 1)
+            for (std::size_t b = first; b < last; ++b) {
+                std::string& out = buffers[b - first];
+                out.clear();
+                const std::size_t end = std::min(count, (b + 1) * BLOCK_RECORDS);
+                for (std::size_t i = b * BLOCK_RECORDS; i < end; ++i) format(i, out);
+            }
+
+            for (std::size_t b = 0; b < last - first; ++b) Write(buffers[b].data(), buffers[b].size());
+        }
+    }
+
+    static inline void Append(std::string& out, const float value)
+    {
+        char buffer[32];
+        auto [ptr, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        out.append(buffer, ptr);
+    }
+
+    static inline void Append(std::string& out, const uint32_t value)
+    {
+        char buffer[16];
+        auto [ptr, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        out.append(buffer, ptr);
+    }
+};
+
+inline bool ExportMesh(const std::string& path,
+                       const float* positions, const std::size_t nVertices,
+                       const uint32_t* indices, const std::size_t nFaces,
+                       const MeshFormat format)
+{
+    if (format == MeshFormat::Binary)
+        return WriteBinaryMesh(path, positions, nVertices, indices, nFaces);
+    if (format == MeshFormat::Other)
+        return false;
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+    std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+    MeshWriter writer(file);
+
+    auto vertex = [&](std::size_t v, std::string& out, const char* prefix) {
+        out += prefix;
+        for (int k = 0; k < 3; ++k) {
+            if (k) out += ' ';
+            MeshWriter::Append(out, positions[3 * v + k]);
+        }
+        out += '\n';
+    };
+
+    auto face = [&](std::size_t f, std::string& out, const char* prefix, const uint32_t base) {
+        out += prefix;
+        for (int k = 0; k < 3; ++k) {
+            out += ' ';
+            MeshWriter::Append(out, indices[3 * f + k] + base);
+        }
+        out += '\n';
+    };
+
+    if (format == MeshFormat::Obj) {
+        writer.Records(nVertices, [&](std::size_t v, std::string& out) { vertex(v, out, "v "); });
+        writer.Records(nFaces,    [&](std::size_t f, std::string& out) { face(f, out, "f", 1); });
+    } else {
+        const std::string header =
+            std::string("ply\nformat ") +
+            (format == MeshFormat::PlyBinary ? "binary_little_endian" : "ascii") + " 1.0\n" +
+            "element vertex " + std::to_string(nVertices) + "\n" +
+            "property float x\nproperty float y\nproperty float z\n" +
+            "element face " + std::to_string(nFaces) + "\n" +
+            "property list uchar int vertex_indices\nend_header\n";
+        writer.Write(header.data(), header.size());
+
+        if (format == MeshFormat::PlyAscii) {
+            writer.Records(nVertices, [&](std::size_t v, std::string& out) { vertex(v, out, ""); });
+            writer.Records(nFaces,    [&](std::size_t f, std::string& out) { face(f, out, "3", 0); });
+        } else {
+            static_assert(std::endian::native == std::endian::little, "Binary PLY export assumes little endian");
+            writer.Write(positions, nVertices * 3 * sizeof(float));
+            writer.Records(nFaces, [&](std::size_t f, std::string& out) {
+                char record[13];
+                record[0] = 3;
+                std::memcpy(record + 1, indices + 3 * f, 3 * sizeof(uint32_t));
+                out.append(record, sizeof(record));
+            });
+        }
+    }
+
+    return std::fclose(file) == 0 && writer.Ok();
+}
+
+// Background export, the arrays are moved into the job so the caller can
+// release or reuse its mesh right away.
+inline std::future<bool> ExportMeshAsync(const std::string& path,
+                                         std::vector<float>&& positions,
+                                         std::vector<uint32_t>&& indices,
+                                         const MeshFormat format)
+{
+    return std::async(std::launch::async,
+        [path, format, positions = std::move(positions), indices = std::move(indices)]() {
+            return ExportMesh(path, positions.data(), positions.size() / 3,
+                              indices.data(), indices.size() / 3, format);
+        });
+}
+
+#endif // !MESH_WRITER_H
@@ -0,0 +1,257 @@
+#ifndef OBJ_STREAM_H
+#define OBJ_STREAM_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <omp.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "massert.h"
+
+// Chunked OBJ reader: the file goes through a fixed size buffer, so memory
+// does not depend on the input size. Only `v` and `f` records are parsed,
+// polygons are fan triangulated and indices are returned 0-based (negative,
+// relative indices are resolved against the vertices read so far). A
+// malformed `v` record fails the read, skipping it would shift the indices
+// of every later face.
+class ObjStream {
+    std::string mPath;
+    std::size_t mChunkBytes;
+
+public:
+    explicit ObjStream(const std::string& path, const std::size_t chunkBytes = 64ull << 20)
+        : mPath(path), mChunkBytes(chunkBytes)
+    {}
+
+    // onVertex(float x, float y, float z), onFace(uint32_t a, uint32_t b, uint32_t c),
+    // onChunk() after every buffer, useful to check memory budgets. Returns
+    // false if the file cannot be read or has malformed vertices.
+    template <typename VertexFn, typename FaceFn, typename ChunkFn>
+    bool Read(VertexFn onVertex, FaceFn onFace, ChunkFn onChunk) const
+    {
+        FILE* file = std::fopen(mPath.c_str(), "rb");
+        if (!file) return false;
+
+        std::vector<char> buffer(mChunkBytes + 1);
+        std::vector<int64_t> polygon;
+        std::size_t carry = 0;
+        uint64_t nVertices = 0;
+        uint64_t malformed = 0;
+
+        while (true) {
+            const std::size_t read = std::fread(buffer.data() + carry, 1, mChunkBytes - carry, file);
+            const std::size_t size = carry + read;
+            const bool eof = read == 0;
+            if (size == 0) break;
+
+            // Only complete lines are parsed, the tail is moved to the front
+            std::size_t end = size;
+            if (!eof) {
+                while (end > 0 && buffer[end - 1] != '\n') --end;
+                ASSERT(end > 0, "OBJ line longer than the stream chunk");
+            }
+
+            const char* it   = buffer.data();
+            const char* last = buffer.data() + end;
+            while (it < last) {
+                const char* eol = static_cast<const char*>(std::memchr(it, '\n', last - it));
+                if (!eol) eol = last;
+                malformed += !ParseLine(it, eol, nVertices, polygon, onVertex, onFace);
+                it = eol + 1;
+            }
+
+            carry = size - end;
+            std::memmove(buffer.data(), buffer.data() + end, carry);
+            onChunk();
+            if (eof) break;
+        }
+
+        std::fclose(file);
+        return malformed == 0;
+    }
+
+    static inline const char* SkipSpaces(const char* it, const char* end)
+    {
+        while (it < end && (*it == ' ' || *it == '\t' || *it == '\r')) ++it;
+        return it;
+    }
+
+    // Counts the records ParseLine would report for a line, without parsing
+    // the vertex coordinates.
+    static inline void CountLine(const char* it, const char* end, uint64_t& nVertices, uint64_t& nTriangles)
+    {
+        it = SkipSpaces(it, end);
+        if (end - it < 2 || (it[1] != ' ' && it[1] != '\t')) return;
+
+        if (it[0] == 'v') {
+            ++nVertices;
+        } else if (it[0] == 'f') {
+            uint64_t corners = 0;
+            it += 2;
+            while (true) {
+                it = SkipSpaces(it, end);
+                int64_t index;
+                auto [ptr, ec] = std::from_chars(it, end, index);
+                if (ec != std::errc()) break;
+                ++corners;
+                it = ptr;
+                while (it < end && *it != ' ' && *it != '\t') ++it;
+            }
+            if (corners > 2) nTriangles += corners - 2;
+        }
+    }
+
+    // False for a `v` record without three coordinates
+    template <typename VertexFn, typename FaceFn>
+    static inline bool ParseLine(const char* it, const char* end, uint64_t& nVertices,
+                                 std::vector<int64_t>& polygon,
+                                 VertexFn& onVertex, FaceFn& onFace)
+    {
+        it = SkipSpaces(it, end);
+        if (end - it < 2 || (it[1] != ' ' && it[1] != '\t')) return true;
+
+        if (it[0] == 'v') {
+            float xyz[3] = {0, 0, 0};
+            it += 2;
+            for (auto& c : xyz) {
+                it = SkipSpaces(it, end);
+                auto [ptr, ec] = std::from_chars(it, end, c);
+                if (ec != std::errc()) return false;
+                it = ptr;
+            }
+            ++nVertices;
+            onVertex(xyz[0], xyz[1], xyz[2]);
+        } else if (it[0] == 'f') {
+            polygon.clear();
+            it += 2;
+            while (true) {
+                it = SkipSpaces(it, end);
+                int64_t index;
+                auto [ptr, ec] = std::from_chars(it, end, index);
+                if (ec != std::errc()) break;
+                polygon.push_back(index < 0 ? int64_t(nVertices) + index : index - 1);
+                it = ptr;
+                while (it < end && *it != ' ' && *it != '\t') ++it; // skip /vt/vn
+            }
+
+            for (std::size_t i = 2; i < polygon.size(); ++i) {
+                onFace(static_cast<uint32_t>(polygon[0]),
+                       static_cast<uint32_t>(polygon[i - 1]),
+                       static_cast<uint32_t>(polygon[i]));
+            }
+        }
+        return true;
+    }
+};
+
+// In-memory parallel OBJ reader: the mapped file is split in byte ranges at
+// line boundaries, a first pass counts the records of every range and a
+// second one parses them straight to their final offsets. Returns false if
+// the file cannot be read or has malformed vertices.
+inline bool ReadObjParallel(const std::string& path,
+                            std::vector<float>& positions,
+                            std::vector<uint32_t>& indices)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+
+    const std::size_t size = st.st_size;
+    positions.clear();
+    indices.clear();
+    if (size == 0) {
+        close(fd);
+        return true;
+    }
+
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    const char* data = static_cast<const char*>(map);
+    const char* end  = data + size;
+
+    // Ranges are a few times the thread count to balance uneven v/f regions
+    const std::size_t nRanges = std::max<std::size_t>(1, std::min<std::size_t>(
+        4 * omp_get_max_threads(), size >> 16));
+    std::vector<const char*> bounds(nRanges + 1, end);
+    bounds[0] = data;
+    for (std::size_t r = 1; r < nRanges; ++r) {
+        const char* it = std::max(bounds[r - 1], data + size * r / nRanges);
+        const char* eol = static_cast<const char*>(std::memchr(it, '\n', end - it));
+        bounds[r] = eol ? eol + 1 : end;
+    }
+
+    auto forEachLine = [&](std::size_t r, auto&& fn) {
+        const char* it = bounds[r];
+        while (it < bounds[r + 1]) {
+            const char* eol = static_cast<const char*>(std::memchr(it, '\n', bounds[r + 1] - it));
+            if (!eol) eol = bounds[r + 1];
+            fn(it, eol);
+            it = eol + 1;
+        }
+    };
+
+    std::vector<uint64_t> vertexBase(nRanges + 1, 0), triangleBase(nRanges + 1, 0);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (std::size_t r = 0; r < nRanges; ++r) {
+        uint64_t nVertices = 0, nTriangles = 0;
+        forEachLine(r, [&](const char* it, const char* eol) {
+            ObjStream::CountLine(it, eol, nVertices, nTriangles);
+        });
+        vertexBase[r + 1]   = nVertices;
+        triangleBase[r + 1] = nTriangles;
+    }
+    for (std::size_t r = 0; r < nRanges; ++r) {
+        vertexBase[r + 1]   += vertexBase[r];
+        triangleBase[r + 1] += triangleBase[r];
+    }
+
+    positions.resize(3 * vertexBase[nRanges]);
+    indices.resize(3 * triangleBase[nRanges]);
+
+    bool consistent = true;
+    #pragma omp parallel for schedule(dynamic, 1) reduction(&&: consistent)
+    for (std::size_t r = 0; r < nRanges; ++r) {
+        // Relative indices resolve against the vertices of the previous ranges
+        uint64_t nVertices = vertexBase[r];
+        float*    p = positions.data() + 3 * vertexBase[r];
+        uint32_t* f = indices.data() + 3 * triangleBase[r];
+        float*    pEnd = positions.data() + 3 * vertexBase[r + 1];
+        uint32_t* fEnd = indices.data() + 3 * triangleBase[r + 1];
+        std::vector<int64_t> polygon;
+
+        auto onVertex = [&](float x, float y, float z) {
+            if (p == pEnd) return;
+            *p++ = x; *p++ = y; *p++ = z;
+        };
+        auto onFace = [&](uint32_t a, uint32_t b, uint32_t c) {
+            if (f == fEnd) return;
+            *f++ = a; *f++ = b; *f++ = c;
+        };
+        bool parsed = true;
+        forEachLine(r, [&](const char* it, const char* eol) {
+            parsed = ObjStream::ParseLine(it, eol, nVertices, polygon, onVertex, onFace) && parsed;
+        });
+        consistent = consistent && parsed && p == pEnd && f == fEnd;
+    }
+
+    munmap(map, size);
+    return consistent;
+}
+
+#endif // !OBJ_STREAM_H
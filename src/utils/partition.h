@@ -0,0 +1,342 @@
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+#include "massert.h"
+#include "logging.h"
+#include "mesh.h"
+
+// Flat copy of a sub-mesh, used to move partitions between threads or ranks.
+// Every vertex keeps its id in the mesh it was cut from, border vertices (the
+// ones shared with another piece) are matched on that id when stitching.
+struct MeshPiece {
+    static constexpr uint32_t InvalidId = std::numeric_limits<uint32_t>::max();
+
+    std::vector<float>    mPoints;      // xyz per vertex
+    std::vector<uint32_t> mFaces;       // 3 local vertex ids per face
+    std::vector<uint32_t> mGlobalIds;   // per vertex
+    std::vector<uint8_t>  mBorder;      // per vertex
+
+    inline std::size_t NumVertices() const { return mGlobalIds.size(); }
+    inline std::size_t NumFaces()    const { return mFaces.size() / 3; }
+
+    inline std::vector<char> Serialize() const
+    {
+        const uint64_t header[2] = { NumVertices(), NumFaces() };
+        std::vector<char> buffer(sizeof(header) +
+                                 mPoints.size()    * sizeof(float) +
+                                 mFaces.size()     * sizeof(uint32_t) +
+                                 mGlobalIds.size() * sizeof(uint32_t) +
+                                 mBorder.size()    * sizeof(uint8_t));
+
+        char* out = buffer.data();
+        auto write = [&](const void* src, std::size_t bytes) {
+            if (bytes) std::memcpy(out, src, bytes);
+            out += bytes;
+        };
+        write(header,            sizeof(header));
+        write(mPoints.data(),    mPoints.size()    * sizeof(float));
+        write(mFaces.data(),     mFaces.size()     * sizeof(uint32_t));
+        write(mGlobalIds.data(), mGlobalIds.size() * sizeof(uint32_t));
+        write(mBorder.data(),    mBorder.size()    * sizeof(uint8_t));
+        return buffer;
+    }
+
+    static inline MeshPiece Deserialize(const char* data, const std::size_t size)
+    {
+        uint64_t header[2];
+        ASSERT(size >= sizeof(header), "Mesh piece buffer too small");
+        std::memcpy(header, data, sizeof(header));
+
+        MeshPiece piece;
+        piece.mPoints.resize(header[0] * 3);
+        piece.mFaces.resize(header[1] * 3);
+        piece.mGlobalIds.resize(header[0]);
+        piece.mBorder.resize(header[0]);
+
+        const char* in = data + sizeof(header);
+        auto read = [&](void* dst, std::size_t bytes) {
+            ASSERT(in + bytes <= data + size, "Mesh piece buffer truncated");
+            if (bytes) std::memcpy(dst, in, bytes);
+            in += bytes;
+        };
+        read(piece.mPoints.data(),    piece.mPoints.size()    * sizeof(float));
+        read(piece.mFaces.data(),     piece.mFaces.size()     * sizeof(uint32_t));
+        read(piece.mGlobalIds.data(), piece.mGlobalIds.size() * sizeof(uint32_t));
+        read(piece.mBorder.data(),    piece.mBorder.size()    * sizeof(uint8_t));
+        return piece;
+    }
+};
+
+inline void SplitFacesKd(const std::vector<Eigen::Vector3f>& centroids,
+                         std::vector<uint32_t>& order,
+                         std::vector<uint32_t>& facePart,
+                         const std::size_t begin, const std::size_t end,
+                         const uint32_t firstPart, const uint32_t parts)
+{
+    if (parts <= 1 || end - begin <= 1) {
+        for (std::size_t i = begin; i < end; ++i)
+            facePart[order[i]] = firstPart;
+        return;
+    }
+
+    Eigen::Vector3f lo = Eigen::Vector3f::Constant( std::numeric_limits<float>::max());
+    Eigen::Vector3f hi = Eigen::Vector3f::Constant(-std::numeric_limits<float>::max());
+    for (std::size_t i = begin; i < end; ++i) {
+        lo = lo.cwiseMin(centroids[order[i]]);
+        hi = hi.cwiseMax(centroids[order[i]]);
+    }
+
+    int axis;
+    (hi - lo).maxCoeff(&axis);
+
+    const uint32_t leftParts = parts / 2;
+    const std::size_t mid = begin + (end - begin) * leftParts / parts;
+    std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                     [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+
+    SplitFacesKd(centroids, order, facePart, begin, mid, firstPart, leftParts);
+    SplitFacesKd(centroids, order, facePart, mid, end, firstPart + leftParts, parts - leftParts);
+}
+
+// Assign every face to one of `parts` pieces with a kd-split on the face
+// centroids, each split is along the longest axis of the current cell and
+// sized proportionally to the number of pieces on each side.
+inline std::vector<uint32_t> PartitionFaces(const Mesh& mesh, const uint32_t parts)
+{
+    const std::size_t n = mesh.n_faces();
+    std::vector<Eigen::Vector3f> centroids(n);
+
+    #pragma omp parallel for
+    for (int i = 0; i < n; ++i) {
+        Eigen::Vector3f c = Eigen::Vector3f::Zero();
+        for (auto fv_it = mesh.fv_iter(Mesh::FaceHandle(i)); fv_it.is_valid(); ++fv_it) {
+            const auto& p = mesh.point(*fv_it);
+            c += Eigen::Vector3f(p[0], p[1], p[2]);
+        }
+        centroids[i] = c / 3.0f;
+    }
+
+    std::vector<uint32_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+
+    std::vector<uint32_t> facePart(n, 0);
+    SplitFacesKd(centroids, order, facePart, 0, n, 0, parts);
+    return facePart;
+}
+
+// Cut the mesh into one piece per part. A vertex is a border vertex when its
+// incident faces belong to more than one part.
+inline std::vector<MeshPiece> SplitMesh(const Mesh& mesh,
+                                        const std::vector<uint32_t>& facePart,
+                                        const uint32_t parts)
+{
+    const std::size_t nVertices = mesh.n_vertices();
+    std::vector<uint8_t> border(nVertices, 0);
+
+    #pragma omp parallel for
+    for (int i = 0; i < nVertices; ++i) {
+        uint32_t part = MeshPiece::InvalidId;
+        for (auto vf_it = mesh.vf_iter(Mesh::VertexHandle(i)); vf_it.is_valid(); ++vf_it) {
+            const uint32_t p = facePart[(*vf_it).idx()];
+            if (part == MeshPiece::InvalidId) part = p;
+            else if (part != p) { border[i] = 1; break; }
+        }
+    }
+
+    std::vector<std::vector<uint32_t>> partFaces(parts);
+    for (uint32_t f = 0; f < facePart.size(); ++f)
+        partFaces[facePart[f]].push_back(f);
+
+    // Non-border vertices belong to a single piece, so their local id can
+    // live in one shared array, border ones go through a per-piece map.
+    std::vector<uint32_t> localIds(nVertices, MeshPiece::InvalidId);
+    std::vector<MeshPiece> pieces(parts);
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int p = 0; p < parts; ++p) {
+        MeshPiece& piece = pieces[p];
+        std::unordered_map<uint32_t, uint32_t> borderIds;
+
+        auto localId = [&](const Mesh::VertexHandle vh) {
+            const uint32_t global = vh.idx();
+            uint32_t* slot;
+            if (border[global]) {
+                auto [it, inserted] = borderIds.try_emplace(global, MeshPiece::InvalidId);
+                slot = &it->second;
+            } else {
+                slot = &localIds[global];
+            }
+
+            if (*slot == MeshPiece::InvalidId) {
+                *slot = static_cast<uint32_t>(piece.mGlobalIds.size());
+                const auto& pt = mesh.point(vh);
+                piece.mPoints.insert(piece.mPoints.end(), {float(pt[0]), float(pt[1]), float(pt[2])});
+                piece.mGlobalIds.push_back(global);
+                piece.mBorder.push_back(border[global]);
+            }
+            return *slot;
+        };
+
+        piece.mFaces.reserve(partFaces[p].size() * 3);
+        for (auto f : partFaces[p]) {
+            for (auto fv_it = mesh.fv_iter(Mesh::FaceHandle(f)); fv_it.is_valid(); ++fv_it)
+                piece.mFaces.push_back(localId(*fv_it));
+        }
+    }
+
+    return pieces;
+}
+
+// Add the face, when it would be non-manifold its corners are replaced by
+// fresh copies of the vertices (as the OpenMesh readers do) so no triangle
+// is dropped. Returns whether the corners were duplicated.
+inline bool AddFaceOrDuplicate(Mesh& mesh, std::array<Mesh::VertexHandle, 3>& corners)
+{
+    if (mesh.add_face(corners[0], corners[1], corners[2]).is_valid())
+        return false;
+
+    for (auto& vh : corners) {
+        const Mesh::Point p = mesh.point(vh);
+        vh = mesh.add_vertex(p);
+    }
+    ASSERT(mesh.add_face(corners[0], corners[1], corners[2]).is_valid(), "Failed to add a duplicated face");
+    return true;
+}
+
+// Append the piece to the mesh, border vertices get the locked status bit and
+// every vertex stores its global id in the given property. The vertices of
+// faces duplicated by AddFaceOrDuplicate, and the ones they copy, are locked
+// too so that they keep their position and are welded back by MergePieces.
+inline void BuildMesh(Mesh& mesh, const MeshPiece& piece,
+                      const OpenMesh::VPropHandleT<uint32_t>& globalIds)
+{
+    std::vector<Mesh::VertexHandle> handles(piece.NumVertices());
+    mesh.reserve(mesh.n_vertices() + piece.NumVertices(),
+                 mesh.n_edges() + piece.NumFaces() * 3 / 2,
+                 mesh.n_faces() + piece.NumFaces());
+
+    for (std::size_t v = 0; v < piece.NumVertices(); ++v) {
+        const float* p = &piece.mPoints[3 * v];
+        handles[v] = mesh.add_vertex(Mesh::Point(p[0], p[1], p[2]));
+        mesh.property(globalIds, handles[v]) = piece.mGlobalIds[v];
+        mesh.status(handles[v]).set_locked(piece.mBorder[v]);
+    }
+
+    std::size_t duplicated = 0;
+    for (std::size_t f = 0; f < piece.NumFaces(); ++f) {
+        const uint32_t* face = &piece.mFaces[3 * f];
+        std::array<Mesh::VertexHandle, 3> corners = {handles[face[0]], handles[face[1]], handles[face[2]]};
+        if (!AddFaceOrDuplicate(mesh, corners)) continue;
+
+        ++duplicated;
+        for (int k = 0; k < 3; ++k) {
+            mesh.property(globalIds, corners[k]) = piece.mGlobalIds[face[k]];
+            mesh.status(corners[k]).set_locked(true);
+            mesh.status(handles[face[k]]).set_locked(true);
+        }
+    }
+
+    if (duplicated) LOG_WARN("%zu non-manifold faces duplicated and locked while building a mesh piece", duplicated);
+}
+
+// Flatten the (garbage collected) mesh back into a piece, locked vertices are
+// the border vertices.
+inline MeshPiece ExtractPiece(const Mesh& mesh,
+                              const OpenMesh::VPropHandleT<uint32_t>& globalIds)
+{
+    MeshPiece piece;
+    piece.mPoints.reserve(mesh.n_vertices() * 3);
+    piece.mGlobalIds.reserve(mesh.n_vertices());
+    piece.mBorder.reserve(mesh.n_vertices());
+    piece.mFaces.reserve(mesh.n_faces() * 3);
+
+    for (auto v_it = mesh.vertices_begin(); v_it != mesh.vertices_end(); ++v_it) {
+        const auto& p = mesh.point(*v_it);
+        piece.mPoints.insert(piece.mPoints.end(), {float(p[0]), float(p[1]), float(p[2])});
+        piece.mGlobalIds.push_back(mesh.property(globalIds, *v_it));
+        piece.mBorder.push_back(mesh.status(*v_it).locked());
+    }
+
+    for (auto f_it = mesh.faces_begin(); f_it != mesh.faces_end(); ++f_it) {
+        for (auto fv_it = mesh.fv_iter(*f_it); fv_it.is_valid(); ++fv_it)
+            piece.mFaces.push_back((*fv_it).idx());
+    }
+
+    return piece;
+}
+
+// Stitch the pieces into one mesh, border vertices with the same global id are
+// merged. Faces still non-manifold after the merge keep duplicated vertices.
+// Returns the merged border vertices.
+inline std::vector<Mesh::VertexHandle> MergePieces(Mesh& mesh,
+                                                   const std::vector<MeshPiece>& pieces)
+{
+    std::unordered_map<uint32_t, Mesh::VertexHandle> borderVertices;
+    std::vector<Mesh::VertexHandle> seams;
+    std::vector<Mesh::VertexHandle> handles;
+    std::size_t duplicated = 0;
+
+    for (const auto& piece : pieces) {
+        handles.resize(piece.NumVertices());
+        for (std::size_t v = 0; v < piece.NumVertices(); ++v) {
+            const float* p = &piece.mPoints[3 * v];
+            if (!piece.mBorder[v]) {
+                handles[v] = mesh.add_vertex(Mesh::Point(p[0], p[1], p[2]));
+                continue;
+            }
+
+            auto [it, inserted] = borderVertices.try_emplace(piece.mGlobalIds[v]);
+            if (inserted) {
+                it->second = mesh.add_vertex(Mesh::Point(p[0], p[1], p[2]));
+                seams.push_back(it->second);
+            }
+            handles[v] = it->second;
+        }
+
+        for (std::size_t f = 0; f < piece.NumFaces(); ++f) {
+            const uint32_t* face = &piece.mFaces[3 * f];
+            std::array<Mesh::VertexHandle, 3> corners = {handles[face[0]], handles[face[1]], handles[face[2]]};
+            duplicated += AddFaceOrDuplicate(mesh, corners);
+        }
+    }
+
+    if (duplicated) LOG_WARN("%zu non-manifold faces duplicated while merging mesh pieces", duplicated);
+    return seams;
+}
+
+// Lock every vertex farther than `rings` edges from the seeds, so that a
+// following pass only works on the band around the seams.
+inline void LockOutsideBand(Mesh& mesh, const std::vector<Mesh::VertexHandle>& seeds,
+                            const int rings)
+{
+    #pragma omp parallel for
+    for (int i = 0; i < mesh.n_vertices(); ++i) {
+        mesh.status(Mesh::VertexHandle(i)).set_locked(true);
+    }
+
+    std::vector<Mesh::VertexHandle> front = seeds, next;
+    for (auto vh : front) mesh.status(vh).set_locked(false);
+
+    for (int r = 0; r < rings && !front.empty(); ++r) {
+        next.clear();
+        for (auto vh : front) {
+            for (auto vv_it = mesh.vv_iter(vh); vv_it.is_valid(); ++vv_it) {
+                if (!mesh.status(*vv_it).locked()) continue;
+                mesh.status(*vv_it).set_locked(false);
+                next.push_back(*vv_it);
+            }
+        }
+        std::swap(front, next);
+    }
+}
+
+#endif // !PARTITION_H
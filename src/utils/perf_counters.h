@@ -0,0 +1,130 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Hardware counters of the calling thread through perf_event_open. Every
+// event is opened on its own, user space only, so a missing PMU (VMs,
+// containers) or perf_event_paranoid only drops the events it affects:
+// Available() is false and the value reads 0. Values are scaled by the
+// enabled / running time when the kernel multiplexes the counters.
+
+enum class PerfEvent { Cycles, Instructions, LlcMisses, BranchMisses, DtlbMisses, Count };
+
+constexpr std::size_t PERF_EVENT_COUNT = static_cast<std::size_t>(PerfEvent::Count);
+
+inline const char* PerfEventName(const PerfEvent event)
+{
+    switch (event) {
+        case PerfEvent::Cycles:       return "cycles";
+        case PerfEvent::Instructions: return "instructions";
+        case PerfEvent::LlcMisses:    return "llc_misses";
+        case PerfEvent::BranchMisses: return "branch_misses";
+        case PerfEvent::DtlbMisses:   return "dtlb_misses";
+        default:                      return "unknown";
+    }
+}
+
+using PerfValues = std::array<uint64_t, PERF_EVENT_COUNT>;
+
+class PerfCounters {
+    std::array<int, PERF_EVENT_COUNT> mFds;
+
+    static int OpenEvent(const PerfEvent event)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        switch (event) {
+            case PerfEvent::Cycles:
+                attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+            case PerfEvent::Instructions:
+                attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+            case PerfEvent::LlcMisses:
+                attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_CACHE_MISSES; break;
+            case PerfEvent::BranchMisses:
+                attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+            case PerfEvent::DtlbMisses:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_DTLB
+                            | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                            | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                break;
+            default:
+                return -1;
+        }
+
+        // Calling thread on any CPU, no group
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+public:
+    PerfCounters()
+    {
+        for (std::size_t i = 0; i < PERF_EVENT_COUNT; ++i)
+            mFds[i] = OpenEvent(static_cast<PerfEvent>(i));
+    }
+
+    ~PerfCounters()
+    {
+        for (const int fd : mFds) {
+            if (fd >= 0) close(fd);
+        }
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    inline bool Available(const PerfEvent event) const { return mFds[static_cast<std::size_t>(event)] >= 0; }
+
+    inline bool AnyAvailable() const
+    {
+        for (const int fd : mFds) {
+            if (fd >= 0) return true;
+        }
+        return false;
+    }
+
+    inline void Start()
+    {
+        for (const int fd : mFds) {
+            if (fd < 0) continue;
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    inline void Stop()
+    {
+        for (const int fd : mFds) {
+            if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+
+    // Counts since Start, the counters keep running if not stopped
+    inline PerfValues Read() const
+    {
+        PerfValues values{};
+        for (std::size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+            if (mFds[i] < 0) continue;
+
+            uint64_t data[3] = {0, 0, 0};  // value, time enabled, time running
+            if (read(mFds[i], data, sizeof(data)) != sizeof(data) || data[2] == 0) continue;
+            values[i] = data[2] < data[1] ? uint64_t(double(data[0]) * double(data[1]) / double(data[2])) : data[0];
+        }
+        return values;
+    }
+};
+
+#endif // !PERF_COUNTERS_H
@@ -3,200 +3,587 @@
 #ifndef PROFILING_H
 #define PROFILING_H
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
-#include <csignal>
-#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <memory>
 #include <mutex>
 #include <ostream>
-#include <ratio>
 #include <sstream>
-#include <stdexcept>
 #include <string>
-#include <variant>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
+#include "bench.h"
 #include "debug.h"
 #include "massert.h"
 #include "logging.h"
+#include "perf_counters.h"
 
-struct ProfNode {
-    using children_type = std::vector<std::shared_ptr<ProfNode>>; 
+// Every thread records into its own preallocated call tree. A scope is an
+// interned name id: entering it finds or appends the child of the current
+// node, leaving it adds the elapsed time, with no allocation or lock once the
+// path has been seen. PROFILING_PRINT merges the trees by name path, so the
+// threads may take different paths, and reports min / avg / max over the
+// threads that ran each scope.
+//
+// A thread other than the main one that opens a scope with none open (an
+// OpenMP worker, an async writer) hangs it under the scope the main thread
+// is in, or under its parent when the main thread runs the same scope (the
+// top of a parallel region).
+//
+// With QEM_TRACE=path in the environment (or ProfilingTraceTo) every thread
+// also keeps the begin / end of its last PROFILING_TRACE_EVENTS scopes in a
+// ring, written by PROFILING_PRINT as a Chrome trace-event JSON.
+//
+// With QEM_COUNTERS=1 (or ProfilingCountersOn) every thread opens its
+// hardware counters and each scope adds their deltas to its node, for two
+// more reads of PERF_EVENT_COUNT counters per scope. Only the threads that
+// open a scope are counted in it, not the workers of a parallel for inside.
+// PROFILING_PRINT shows IPC and the misses per element given with
+// PROFILING_ELEMENTS, and writes the whole tree to QEM_PROFILE_JSON=path (or
+// ProfilingJsonTo) if set.
 
-    std::string mName = "";
-    float mValue  = 0.0;
-    children_type mChildren;
+constexpr uint32_t PROFILING_NONE         = UINT32_MAX;
+constexpr uint32_t PROFILING_MAX_NODES    = 1u << 12; // distinct call paths per thread
+constexpr uint32_t PROFILING_TRACE_EVENTS = 1u << 18; // per thread, power of two
 
-    inline bool IsLeaf() const { return mChildren.size() == 0; }
+struct ProfNode {
+    uint32_t   mId          = PROFILING_NONE;
+    uint32_t   mParent      = PROFILING_NONE;
+    uint32_t   mFirstChild  = PROFILING_NONE;
+    uint32_t   mNextSibling = PROFILING_NONE;
+    uint64_t   mCount       = 0;
+    int64_t    mTotalNs     = 0;
+    uint64_t   mElements    = 0;
+    PerfValues mCounts      = {};
 };
 
-inline std::vector<std::shared_ptr<ProfNode>>               __SavedProfilingStack;
-inline std::shared_ptr<ProfNode>                            __SavedProfilingRoot;
-inline float                                                __SavedDeltaTime = 0;
+struct ProfTraceEvent {
+    uint32_t mId;
+    int64_t  mBeginNs;
+    int64_t  mEndNs;
+};
 
-inline std::shared_ptr<ProfNode>                            __GlobalProfilingRoot;
-inline unsigned int                                         __GlobalProfilingRootCount;
-inline std::mutex                                           __GlobalProfilingRootMutex;
+struct ProfThread {
+    std::unique_ptr<ProfNode[]> mNodes{new ProfNode[PROFILING_MAX_NODES]};
+    uint32_t                    mSize = 1; // node 0 is the root
+    std::atomic<uint32_t>       mCurrent{0};
+    uint64_t                    mDropped = 0;
+    bool                        mMain = false;
 
-thread_local inline std::shared_ptr<ProfNode>               __LocalProfilingRoot;
-thread_local inline std::vector<std::shared_ptr<ProfNode>>  __LocalProfilingStack;
+    // Ring of the last scopes, allocated on the first one traced
+    std::unique_ptr<ProfTraceEvent[]> mTrace;
+    uint64_t                          mTraceCount = 0;
 
-inline std::string ProfilingPrint(const std::shared_ptr<ProfNode>& node, int depth = 0) {
-    std::string tabs(depth, '\t');
-    std::ostringstream oss;
+    std::unique_ptr<PerfCounters>     mCounters;
+
+    inline void Reset()
+    {
+        mNodes[0] = ProfNode{};
+        mSize = 1;
+        mCurrent.store(0, std::memory_order_relaxed);
+        mDropped = 0;
+    }
+
+    // Child of parent for scope id, appended on first use
+    inline uint32_t Child(const uint32_t parent, const uint32_t id)
+    {
+        uint32_t* link = &mNodes[parent].mFirstChild;
+        while (*link != PROFILING_NONE) {
+            if (mNodes[*link].mId == id) return *link;
+            link = &mNodes[*link].mNextSibling;
+        }
 
-    oss << tabs << "[" << node->mName << "]: " << node->mValue << " ms \n";
-    if (!node->IsLeaf()) {
-        for (auto& el : node->mChildren) {
-            oss << ProfilingPrint(el, depth + 1);
+        if (mSize == PROFILING_MAX_NODES) {
+            ++mDropped;
+            return PROFILING_NONE;
         }
+
+        const uint32_t node = mSize++;
+        mNodes[node] = ProfNode{};
+        mNodes[node].mId = id;
+        mNodes[node].mParent = parent;
+        *link = node;
+        return node;
     }
 
-    return oss.str();
+    inline void Trace(const uint32_t id, const int64_t beginNs, const int64_t endNs)
+    {
+        if (!mTrace) [[unlikely]] mTrace.reset(new ProfTraceEvent[PROFILING_TRACE_EVENTS]);
+        mTrace[mTraceCount++ & (PROFILING_TRACE_EVENTS - 1)] = {id, beginNs, endNs};
+    }
+
+    // Opened and started on the first scope counted, runs until the thread data goes
+    inline PerfCounters& Counters()
+    {
+        if (!mCounters) [[unlikely]] {
+            mCounters = std::make_unique<PerfCounters>();
+            mCounters->Start();
+            if (!mCounters->AnyAvailable()) {
+                static std::atomic<bool> warned{false};
+                if (!warned.exchange(true))
+                    LOG_WARN("No hardware counters available (perf_event_paranoid, VM or container), timing only");
+            }
+        }
+        return *mCounters;
+    }
+
+    inline bool Counted(const std::size_t event) const
+    {
+        return mCounters && mCounters->Available(static_cast<PerfEvent>(event));
+    }
+};
+
+// Per-thread data stays registered after the thread exits, until the merge
+inline const std::thread::id                        __ProfilingMainThread = std::this_thread::get_id();
+inline std::mutex                                   __ProfilingMutex;
+inline std::vector<std::unique_ptr<ProfThread>>     __ProfilingThreads;
+inline std::atomic<ProfThread*>                     __ProfilingMain{nullptr};
+inline std::vector<std::string>                     __ProfilingNames;
+inline std::unordered_map<std::string, uint32_t>    __ProfilingIds;
+
+inline const auto                                   __ProfilingEpoch = std::chrono::steady_clock::now();
+inline std::string                                  __ProfilingTracePath = [] {
+    const char* path = std::getenv("QEM_TRACE");
+    return path ? std::string(path) : std::string();
+}();
+inline std::atomic<bool>                            __ProfilingTracing{!__ProfilingTracePath.empty()};
+inline std::atomic<bool>                            __ProfilingCounting{[] {
+    const char* on = std::getenv("QEM_COUNTERS");
+    return on != nullptr && std::string(on) != "0";
+}()};
+inline std::string                                  __ProfilingJsonPath = [] {
+    const char* path = std::getenv("QEM_PROFILE_JSON");
+    return path ? std::string(path) : std::string();
+}();
+
+thread_local inline ProfThread*                     __LocalProfilingThread = nullptr;
+
+// Before the first scope, replaces QEM_TRACE
+inline void ProfilingTraceTo(const std::string& path)
+{
+    __ProfilingTracePath = path;
+    __ProfilingTracing.store(!path.empty());
+}
+
+// Before the first scope, replaces QEM_COUNTERS
+inline void ProfilingCountersOn(const bool on)
+{
+    __ProfilingCounting.store(on);
+}
+
+// Before PROFILING_PRINT, replaces QEM_PROFILE_JSON
+inline void ProfilingJsonTo(const std::string& path)
+{
+    __ProfilingJsonPath = path;
+}
+
+inline uint32_t ProfilingIntern(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(__ProfilingMutex);
+    const auto [it, inserted] = __ProfilingIds.try_emplace(name, static_cast<uint32_t>(__ProfilingNames.size()));
+    if (inserted) __ProfilingNames.push_back(name);
+    return it->second;
 }
 
-inline void ProfilingCleanup() {
-    __GlobalProfilingRoot.reset();
-    __GlobalProfilingRootCount = 0;
-    __LocalProfilingRoot.reset();
-    __LocalProfilingStack.clear();
+// Last id of one PROFILING_SCOPE on one thread: literals are matched by
+// pointer, built names by value
+struct ProfSite {
+    const char* mLiteral = nullptr;
+    std::string mName;
+    uint32_t    mId = PROFILING_NONE;
+};
+
+inline uint32_t ProfilingSiteId(ProfSite& site, const char* name)
+{
+    if (site.mLiteral != name || site.mId == PROFILING_NONE) {
+        site.mLiteral = name;
+        site.mId = ProfilingIntern(name);
+    }
+    return site.mId;
 }
 
-inline void ProfilingLock()
+inline uint32_t ProfilingSiteId(ProfSite& site, const std::string& name)
 {
-    __SavedProfilingStack.clear();
-    __SavedProfilingRoot.reset();
+    if (site.mLiteral != nullptr || site.mId == PROFILING_NONE || site.mName != name) {
+        site.mLiteral = nullptr;
+        site.mName = name;
+        site.mId = ProfilingIntern(name);
+    }
+    return site.mId;
+}
 
-    for (const auto& ptr : __LocalProfilingStack)
-        __SavedProfilingStack.push_back(ptr);
-    __SavedProfilingRoot = __LocalProfilingRoot;
+inline ProfThread& ProfilingLocalThread()
+{
+    if (__LocalProfilingThread == nullptr) [[unlikely]] {
+        auto thread = std::make_unique<ProfThread>();
+        thread->mMain = std::this_thread::get_id() == __ProfilingMainThread;
 
-    __GlobalProfilingRoot.reset();
-    __GlobalProfilingRootCount = 0;
+        std::lock_guard<std::mutex> lock(__ProfilingMutex);
+        __LocalProfilingThread = thread.get();
+        if (thread->mMain) __ProfilingMain.store(thread.get(), std::memory_order_release);
+        __ProfilingThreads.push_back(std::move(thread));
+    }
+    return *__LocalProfilingThread;
+}
 
-    __LocalProfilingStack.clear();
-    __LocalProfilingRoot.reset();
+// Node of local mirroring node n of the main thread. Ids and parents of the
+// main thread's nodes are written before they become current, so they can be
+// read while it keeps running.
+inline uint32_t ProfilingMirror(ProfThread& local, const ProfThread& main, const uint32_t n)
+{
+    if (n == 0) return 0;
+    const uint32_t parent = ProfilingMirror(local, main, main.mNodes[n].mParent);
+    return parent == PROFILING_NONE ? PROFILING_NONE : local.Child(parent, main.mNodes[n].mId);
 }
 
-inline void ProfilingUnLock()
+inline uint32_t ProfilingForkNode(ProfThread& local, const uint32_t id)
 {
-    __LocalProfilingStack.clear();
-    __LocalProfilingRoot.reset();
+    const ProfThread* main = __ProfilingMain.load(std::memory_order_acquire);
+    if (main == nullptr || main == &local) return 0;
 
-    for (const auto& ptr : __SavedProfilingStack)
-        __LocalProfilingStack.push_back(ptr);
-    __LocalProfilingRoot = __SavedProfilingRoot;
+    uint32_t at = main->mCurrent.load(std::memory_order_acquire);
+    for (uint32_t n = at; n != 0; n = main->mNodes[n].mParent) {
+        if (main->mNodes[n].mId == id) {
+            at = main->mNodes[n].mParent;
+            break;
+        }
+    }
 
-    auto parent = __LocalProfilingStack.back();
-    parent->mChildren.push_back(__GlobalProfilingRoot);
+    const uint32_t node = ProfilingMirror(local, *main, at);
+    return node == PROFILING_NONE ? 0 : node;
+}
 
-    __GlobalProfilingRoot.reset();
-    __GlobalProfilingRootCount = 0;
+// Elements processed by the innermost open scope of the calling thread, the
+// counters are reported per element. Inside parallel regions only one thread
+// should give the total.
+inline void ProfilingElements(const uint64_t n)
+{
+    ProfThread& thread = ProfilingLocalThread();
+    const uint32_t node = thread.mCurrent.load(std::memory_order_relaxed);
+    if (node != 0) thread.mNodes[node].mElements += n;
 }
 
-inline void ProfilingMergeTree(const std::shared_ptr<ProfNode>& global, 
-                               const std::shared_ptr<ProfNode>& local, 
-                               int count) 
+// Only with no scope open on any thread, the trace rings are kept until
+// ProfilingWriteTrace
+inline void ProfilingCleanup()
 {
-    ASSERT(global->mName == local->mName, 
-           "Trees are not equal (" + global->mName + "!=" + local->mName + ")");
+    std::lock_guard<std::mutex> lock(__ProfilingMutex);
+    for (const auto& thread : __ProfilingThreads) thread->Reset();
+}
+
+// Scope merged over the threads, times are the per-thread totals
+struct ProfReportNode {
+    uint32_t                           mId       = PROFILING_NONE;
+    std::vector<uint32_t>              mChildren;
+    uint32_t                           mThreads  = 0;
+    uint64_t                           mCalls    = 0;
+    double                             mMinMs    = 0.0;
+    double                             mMaxMs    = 0.0;
+    double                             mSumMs    = 0.0;
+    uint64_t                           mElements = 0;
+    PerfValues                         mCounts   = {};
+    std::array<bool, PERF_EVENT_COUNT> mCounted  = {}; // by at least one thread
+
+    inline double AvgMs() const { return mThreads > 0 ? mSumMs / mThreads : 0.0; }
+
+    inline bool AnyCounted() const
+    {
+        return std::find(mCounted.begin(), mCounted.end(), true) != mCounted.end();
+    }
+
+    // -1 if not counted
+    inline double Ipc() const
+    {
+        const auto cycles = static_cast<std::size_t>(PerfEvent::Cycles);
+        const auto instructions = static_cast<std::size_t>(PerfEvent::Instructions);
+        if (!mCounted[cycles] || !mCounted[instructions] || mCounts[cycles] == 0) return -1.0;
+        return double(mCounts[instructions]) / double(mCounts[cycles]);
+    }
 
-    if (global->IsLeaf()) {
-        global->mValue += (local->mValue - global->mValue) / count;
-    } else {
-        ASSERT(global->mChildren.size() == local->mChildren.size(), 
-               "Trees are not the same children number");
+    inline double PerElement(const std::size_t event) const
+    {
+        if (!mCounted[event] || mElements == 0) return -1.0;
+        return double(mCounts[event]) / double(mElements);
+    }
+};
 
-        for (int i = 0; i < global->mChildren.size(); ++i) {
-            ProfilingMergeTree(global->mChildren[i], local->mChildren[i], count);
+// Union of the thread trees by name path, node 0 is the root
+inline std::vector<ProfReportNode> ProfilingMerge(uint64_t* dropped = nullptr)
+{
+    std::vector<ProfReportNode> report(1);
+    if (dropped) *dropped = 0;
+
+    std::lock_guard<std::mutex> lock(__ProfilingMutex);
+    for (const auto& thread : __ProfilingThreads) {
+        if (dropped) *dropped += thread->mDropped;
+
+        // Nodes come after their parent, one pass maps them in order
+        std::vector<uint32_t> merged(thread->mSize, 0);
+        for (uint32_t n = 1; n < thread->mSize; ++n) {
+            const ProfNode& node = thread->mNodes[n];
+            const uint32_t parent = merged[node.mParent];
+
+            uint32_t m = PROFILING_NONE;
+            for (const uint32_t c : report[parent].mChildren) {
+                if (report[c].mId == node.mId) {
+                    m = c;
+                    break;
+                }
+            }
+            if (m == PROFILING_NONE) {
+                m = static_cast<uint32_t>(report.size());
+                report.emplace_back().mId = node.mId;
+                report[parent].mChildren.push_back(m);
+            }
+            merged[n] = m;
+
+            // Fork paths mirrored by workers are not timed
+            if (node.mCount == 0) continue;
+
+            ProfReportNode& r = report[m];
+            const double ms = double(node.mTotalNs) * 1e-6;
+            r.mMinMs = r.mThreads == 0 ? ms : std::min(r.mMinMs, ms);
+            r.mMaxMs = r.mThreads == 0 ? ms : std::max(r.mMaxMs, ms);
+            r.mSumMs += ms;
+            r.mCalls += node.mCount;
+            ++r.mThreads;
+
+            r.mElements += node.mElements;
+            for (std::size_t e = 0; e < PERF_EVENT_COUNT; ++e) {
+                if (!thread->Counted(e)) continue;
+                r.mCounts[e] += node.mCounts[e];
+                r.mCounted[e] = true;
+            }
+        }
+    }
+
+    return report;
+}
+
+inline std::string ProfilingName(const uint32_t id)
+{
+    std::lock_guard<std::mutex> lock(__ProfilingMutex);
+    return id < __ProfilingNames.size() ? __ProfilingNames[id] : std::string();
+}
+
+inline std::string ProfilingPrint(const std::vector<ProfReportNode>& report, const uint32_t n = 0, int depth = -1)
+{
+    std::ostringstream oss;
+    const ProfReportNode& node = report[n];
+
+    if (n != 0) {
+        oss << std::string(depth, '\t') << "[" << ProfilingName(node.mId) << "]: " << node.AvgMs() << " ms";
+        if (node.mThreads > 1)
+            oss << " (" << node.mThreads << " threads, min " << node.mMinMs << " ms, max " << node.mMaxMs << " ms)";
+        if (node.mCalls > node.mThreads)
+            oss << " (" << node.mCalls << " calls)";
+        if (node.AnyCounted()) {
+            std::ostringstream counters;
+            if (node.Ipc() >= 0.0) counters << ", IPC " << node.Ipc();
+            if (node.mElements > 0) counters << ", " << node.mElements << " elements";
+            for (const PerfEvent event : {PerfEvent::LlcMisses, PerfEvent::BranchMisses, PerfEvent::DtlbMisses}) {
+                const auto e = static_cast<std::size_t>(event);
+                if (!node.mCounted[e]) continue;
+                counters << ", " << PerfEventName(event) << " ";
+                if (node.mElements > 0) counters << node.PerElement(e) << "/element";
+                else counters << node.mCounts[e];
+            }
+            if (counters.tellp() > 0) oss << " {" << counters.str().substr(2) << "}";
         }
+        oss << " \n";
+    }
+
+    for (const uint32_t c : node.mChildren) {
+        oss << ProfilingPrint(report, c, depth + 1);
     }
+
+    return oss.str();
 }
 
+// Merged tree as JSON, counters not counted and per element values without
+// elements are -1
+inline std::string ProfilingJson(const std::vector<ProfReportNode>& report, const uint32_t n = 0, int depth = 0)
+{
+    std::ostringstream oss;
+    const ProfReportNode& node = report[n];
+    const std::string tabs(2 * depth, ' ');
+
+    oss << "{";
+    if (n != 0) {
+        oss << "\"name\": " << JsonString(ProfilingName(node.mId)) << ", \"avg_ms\": " << node.AvgMs()
+            << ", \"min_ms\": " << node.mMinMs << ", \"max_ms\": " << node.mMaxMs
+            << ", \"threads\": " << node.mThreads << ", \"calls\": " << node.mCalls
+            << ", \"elements\": " << node.mElements << ",\n" << tabs << " \"counters\": {";
+        for (std::size_t e = 0; e < PERF_EVENT_COUNT; ++e) {
+            oss << "\"" << PerfEventName(static_cast<PerfEvent>(e)) << "\": "
+                << (node.mCounted[e] ? int64_t(node.mCounts[e]) : int64_t(-1)) << ", ";
+        }
+        oss << "\"ipc\": " << node.Ipc();
+        for (const PerfEvent event : {PerfEvent::LlcMisses, PerfEvent::BranchMisses, PerfEvent::DtlbMisses}) {
+            oss << ", \"" << PerfEventName(event) << "_per_element\": " << node.PerElement(static_cast<std::size_t>(event));
+        }
+        oss << "},\n" << tabs << " ";
+    }
+
+    oss << "\"children\": [";
+    for (std::size_t i = 0; i < node.mChildren.size(); ++i) {
+        oss << (i ? "," : "") << "\n" << tabs << "  " << ProfilingJson(report, node.mChildren[i], depth + 1);
+    }
+    oss << "]}";
+    return oss.str();
+}
+
+inline bool ProfilingWriteJson(const std::vector<ProfReportNode>& report)
+{
+    if (__ProfilingJsonPath.empty()) return true;
+
+    std::ofstream out(__ProfilingJsonPath);
+    out << ProfilingJson(report) << "\n";
+    if (!out.good()) {
+        LOG_WARN("Error writing profile %s", __ProfilingJsonPath.c_str());
+        return false;
+    }
+    LOG_INFO("Profile written to %s", __ProfilingJsonPath.c_str());
+    return true;
+}
+
+// Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev) of the scopes
+// traced since the last write. Threads are numbered in order of their first
+// scope, events lost to the rings are counted in otherData.
+inline bool ProfilingWriteTrace()
+{
+    if (!__ProfilingTracing.load()) return true;
+
+    std::lock_guard<std::mutex> lock(__ProfilingMutex);
+    std::ofstream out(__ProfilingTracePath);
+    if (!out.good()) {
+        LOG_WARN("Error opening trace %s", __ProfilingTracePath.c_str());
+        return false;
+    }
+
+    std::vector<std::string> names;
+    names.reserve(__ProfilingNames.size());
+    for (const auto& name : __ProfilingNames) names.push_back(JsonString(name));
+
+    uint64_t events = 0;
+    uint64_t dropped = 0;
+    out << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    for (std::size_t t = 0; t < __ProfilingThreads.size(); ++t) {
+        ProfThread& thread = *__ProfilingThreads[t];
+        out << (t ? "," : "") << "\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << t
+            << ", \"args\": {\"name\": " << JsonString(thread.mMain ? "main" : "thread " + std::to_string(t)) << "}}";
+        if (!thread.mTrace) continue;
+
+        const uint64_t kept = std::min<uint64_t>(thread.mTraceCount, PROFILING_TRACE_EVENTS);
+        for (uint64_t i = thread.mTraceCount - kept; i < thread.mTraceCount; ++i) {
+            const ProfTraceEvent& event = thread.mTrace[i & (PROFILING_TRACE_EVENTS - 1)];
+            out << ",\n{\"name\": " << names[event.mId] << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << t
+                << ", \"ts\": " << double(event.mBeginNs) * 1e-3
+                << ", \"dur\": " << double(event.mEndNs - event.mBeginNs) * 1e-3 << "}";
+        }
+        events += kept;
+        dropped += thread.mTraceCount - kept;
+        thread.mTraceCount = 0;
+    }
+    out << "\n], \"otherData\": {\"dropped_events\": " << dropped << "}}\n";
+
+    if (!out.good()) {
+        LOG_WARN("Error writing trace %s", __ProfilingTracePath.c_str());
+        return false;
+    }
+    LOG_INFO("Trace of %lu scopes written to %s", static_cast<unsigned long>(events), __ProfilingTracePath.c_str());
+    if (dropped > 0)
+        LOG_WARN("Trace dropped the %lu oldest scopes, more than %u per thread",
+                 static_cast<unsigned long>(dropped), PROFILING_TRACE_EVENTS);
+    return true;
+}
 
 class Profiling {
-    std::string mMsg;
-    std::chrono::high_resolution_clock::time_point mStart;
-    std::shared_ptr<ProfNode> mNode;
+    ProfThread&                           mThread;
+    uint32_t                              mId;
+    uint32_t                              mNode;
+    uint32_t                              mParent;
+    bool                                  mCounting;
+    PerfValues                            mStartCounts;
+    std::chrono::steady_clock::time_point mStart;
 
 public:
-    Profiling(const std::string& msg = "")
-        : mMsg(msg), mStart(std::chrono::high_resolution_clock::now())
+    explicit Profiling(const uint32_t id)
+        : mThread(ProfilingLocalThread()), mId(id)
     {
-        auto child = std::make_shared<ProfNode>(msg);
-        if (!__LocalProfilingStack.empty()) {
-            auto parent = __LocalProfilingStack.back();
-            parent->mChildren.push_back(child);
-        } else {
-            __LocalProfilingRoot = child;
-        }
-        __LocalProfilingStack.push_back(child);
-        mNode = child;
+        mParent = mThread.mCurrent.load(std::memory_order_relaxed);
+        const uint32_t parent = mParent == 0 && !mThread.mMain ? ProfilingForkNode(mThread, id) : mParent;
+
+        mNode = mThread.Child(parent, id);
+        if (mNode != PROFILING_NONE) mThread.mCurrent.store(mNode, std::memory_order_release);
+
+        mCounting = __ProfilingCounting.load(std::memory_order_relaxed);
+        if (mCounting) mStartCounts = mThread.Counters().Read();
+        mStart = std::chrono::steady_clock::now();
     }
 
     ~Profiling()
     {
-        auto end = std::chrono::high_resolution_clock::now();
-        float delta = static_cast<float>(
-            std::chrono::duration<double, std::milli>(end - mStart).count()
-        );
-        mNode->mValue += delta;
-        __LocalProfilingStack.pop_back();
-
-        if (__LocalProfilingStack.empty()) {
-            std::lock_guard<std::mutex> lock(__GlobalProfilingRootMutex);
-            __GlobalProfilingRootCount++;
-            if (!__GlobalProfilingRoot) {
-                __GlobalProfilingRoot = std::make_shared<ProfNode>(*__LocalProfilingRoot);
-            } else {
-                ProfilingMergeTree(
-                    __GlobalProfilingRoot, 
-                    __LocalProfilingRoot, 
-                    __GlobalProfilingRootCount
-                );
+        const auto end = std::chrono::steady_clock::now();
+        if (__ProfilingTracing.load(std::memory_order_relaxed)) {
+            mThread.Trace(mId,
+                          std::chrono::duration_cast<std::chrono::nanoseconds>(mStart - __ProfilingEpoch).count(),
+                          std::chrono::duration_cast<std::chrono::nanoseconds>(end - __ProfilingEpoch).count());
+        }
+        if (mNode == PROFILING_NONE) return;
+
+        ProfNode& node = mThread.mNodes[mNode];
+        node.mTotalNs += std::chrono::duration_cast<std::chrono::nanoseconds>(end - mStart).count();
+        ++node.mCount;
+
+        if (mCounting) {
+            const PerfValues counts = mThread.mCounters->Read();
+            for (std::size_t e = 0; e < PERF_EVENT_COUNT; ++e) {
+                // Scaled values of multiplexed counters may step back
+                if (counts[e] > mStartCounts[e]) node.mCounts[e] += counts[e] - mStartCounts[e];
             }
-        } 
+        }
+        mThread.mCurrent.store(mParent, std::memory_order_release);
     }
-    
+
+    Profiling(const Profiling&) = delete;
+    Profiling& operator=(const Profiling&) = delete;
 };
 
+#define PROFILING_CONCAT_INNER(a, b) a##b
+#define PROFILING_CONCAT(a, b) PROFILING_CONCAT_INNER(a, b)
+
 #if PROFILING
     #define PROFILING_PRINT() {                                                           \
-        std::lock_guard<std::mutex> lock(__GlobalProfilingRootMutex);                     \
-        ASSERT(__GlobalProfilingRoot != nullptr, "Global Profiling Root are invalid");    \
-        std::cout << ProfilingPrint(__GlobalProfilingRoot);                               \
+        uint64_t dropped = 0;                                                             \
+        const auto report = ProfilingMerge(&dropped);                                     \
+        std::cout << ProfilingPrint(report);                                              \
+        if (dropped > 0)                                                                  \
+            LOG_WARN("Profiling dropped %lu scopes, more than %u call paths",             \
+                     static_cast<unsigned long>(dropped), PROFILING_MAX_NODES);           \
+        ProfilingWriteJson(report);                                                       \
+        ProfilingWriteTrace();                                                            \
         ProfilingCleanup();                                                               \
     }
-    
-    
-    #define PROFILING_LOCK() {                                              \
-        auto start = std::chrono::high_resolution_clock::now();             \
-        ProfilingLock();                                                    \
-        auto end = std::chrono::high_resolution_clock::now();               \
-        __SavedDeltaTime += static_cast<float>(                             \
-            std::chrono::duration<double, std::milli>(end - start).count()  \
-        );                                                                  \
-    }
-    
-    #define PROFILING_UNLOCK() {                                            \
-        auto start = std::chrono::high_resolution_clock::now();             \
-        ProfilingUnLock();                                                  \
-        auto end = std::chrono::high_resolution_clock::now();               \
-        __SavedDeltaTime += static_cast<float>(                             \
-            std::chrono::duration<double, std::milli>(end - start).count()  \
-        );                                                                  \
-        __LocalProfilingStack.back()->mValue -= __SavedDeltaTime;           \
-        __SavedDeltaTime = 0;                                               \
-    }
-    
-    #define PROFILING_SCOPE(msg) Profiling timer##__LINE__(msg)
-#else 
+
+    #define PROFILING_SCOPE(msg) Profiling PROFILING_CONCAT(timer, __LINE__)(             \
+        ProfilingSiteId([]() -> ProfSite& { thread_local ProfSite site; return site; }(), msg))
+
+    #define PROFILING_ELEMENTS(n) ProfilingElements(n)
+#else
     #pragma message("Profiling are not availble")
     #define PROFILING_PRINT()
-    #define PROFILING_LOCK()
-    #define PROFILING_UNLOCK()
     #define PROFILING_SCOPE(msg)
+    #define PROFILING_ELEMENTS(n)
 #endif
 
 #endif // !PROFILING_H
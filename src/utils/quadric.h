@@ -0,0 +1,164 @@
+#ifndef QUADRIC_H
+#define QUADRIC_H
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <Eigen/Dense>
+
+// Singularity threshold of Solve relative to the cube of the trace of the
+// 3x3 block (the summed plane weights). Float sums carry enough rounding
+// that nearly flat neighborhoods look solvable and the solution lands far
+// from the edge, double only uses the absolute epsilon.
+template <typename T>
+constexpr T SOLVE_RELATIVE_EPSILON = std::is_same_v<T, float> ? T(1e-4) : T(0);
+
+// Symmetric 4x4 error quadric, only the upper triangle is stored:
+//
+//      | m0 m1 m2 m3 |
+//      |    m4 m5 m6 |
+//      |       m7 m8 |
+//      |          m9 |
+//
+// The coefficients live in a flat array so add/scale loops vectorize.
+template <typename T>
+struct SymQuadricT {
+    using Scalar  = T;
+    using Vector3 = Eigen::Matrix<T, 3, 1>;
+    using Vector4 = Eigen::Matrix<T, 4, 1>;
+
+    alignas(16) std::array<T, 10> m{};
+
+    static inline SymQuadricT FromPlane(T a, T b, T c, T d)
+    {
+        SymQuadricT q;
+        q.m = { a*a, a*b, a*c, a*d,
+                     b*b, b*c, b*d,
+                          c*c, c*d,
+                               d*d };
+        return q;
+    }
+
+    static inline SymQuadricT FromPlane(const Vector4& plane)
+    {
+        return FromPlane(plane[0], plane[1], plane[2], plane[3]);
+    }
+
+    inline SymQuadricT& operator+=(const SymQuadricT& other)
+    {
+        for (std::size_t i = 0; i < m.size(); ++i)
+            m[i] += other.m[i];
+        return *this;
+    }
+
+    inline SymQuadricT operator+(const SymQuadricT& other) const
+    {
+        SymQuadricT result = *this;
+        result += other;
+        return result;
+    }
+
+    // v^T Q v with v = (p, 1)
+    inline T Evaluate(const Vector3& p) const
+    {
+        const T x = p.x(), y = p.y(), z = p.z();
+        return x * (m[0]*x + 2 * (m[1]*y + m[2]*z + m[3]))
+             + y * (m[4]*y + 2 * (m[5]*z + m[6]))
+             + z * (m[7]*z + 2 * m[8])
+             + m[9];
+    }
+
+    // Determinant of the upper 3x3 block, equal to the determinant of the
+    // 4x4 system [A b; 0 1] used to find the optimal vertex.
+    inline T Determinant() const
+    {
+        return m[0] * (m[4]*m[7] - m[5]*m[5])
+             - m[1] * (m[1]*m[7] - m[5]*m[2])
+             + m[2] * (m[1]*m[5] - m[4]*m[2]);
+    }
+
+    // Minimizer of Evaluate, i.e. the solution of A p = -b. Returns false
+    // (leaving p untouched) when the system is close to singular.
+    inline bool Solve(Vector3& p, const T epsilon = T(1e-12)) const
+    {
+        const T det = Determinant();
+        const T trace = m[0] + m[4] + m[7];
+        if (!(std::fabs(det) > epsilon + SOLVE_RELATIVE_EPSILON<T> * trace * trace * trace))
+            return false;
+
+        const T c00 = m[4]*m[7] - m[5]*m[5];
+        const T c01 = m[2]*m[5] - m[1]*m[7];
+        const T c02 = m[1]*m[5] - m[2]*m[4];
+        const T c11 = m[0]*m[7] - m[2]*m[2];
+        const T c12 = m[1]*m[2] - m[0]*m[5];
+        const T c22 = m[0]*m[4] - m[1]*m[1];
+
+        const T invDet = T(1) / det;
+        p.x() = -(c00*m[3] + c01*m[6] + c02*m[8]) * invDet;
+        p.y() = -(c01*m[3] + c11*m[6] + c12*m[8]) * invDet;
+        p.z() = -(c02*m[3] + c12*m[6] + c22*m[8]) * invDet;
+        return true;
+    }
+
+    inline Eigen::Matrix<T, 4, 4> ToMatrix() const
+    {
+        Eigen::Matrix<T, 4, 4> Q;
+        Q << m[0], m[1], m[2], m[3],
+             m[1], m[4], m[5], m[6],
+             m[2], m[5], m[7], m[8],
+             m[3], m[6], m[8], m[9];
+        return Q;
+    }
+};
+
+// Scalar of the quadrics and edge errors, positions stay float. The build
+// compiles every simplifier twice from the same source, the _f32
+// executables define QEM_SCALAR_FLOAT and move half the quadric bytes.
+#ifdef QEM_SCALAR_FLOAT
+using QuadricScalar = float;
+#else
+using QuadricScalar = double;
+#endif
+
+using SymQuadric = SymQuadricT<QuadricScalar>;
+
+constexpr const char* QUADRIC_SCALAR_NAME = std::is_same_v<QuadricScalar, float> ? "float" : "double";
+
+// Where the surviving vertex of a collapse is placed: the minimizer of the
+// edge quadric (falling back to the best of the endpoints and the midpoint),
+// the best endpoint, or the midpoint. The policy is a template argument of
+// the edge kernels so each instantiation only contains its own path.
+enum class Placement { Optimal, Endpoints, Midpoint };
+
+inline bool ParsePlacement(const std::string& name, Placement& placement)
+{
+    if (name == "optimal")   { placement = Placement::Optimal;   return true; }
+    if (name == "endpoints") { placement = Placement::Endpoints; return true; }
+    if (name == "midpoint")  { placement = Placement::Midpoint;  return true; }
+    return false;
+}
+
+inline const char* PlacementName(const Placement placement)
+{
+    switch (placement) {
+        case Placement::Endpoints: return "endpoints";
+        case Placement::Midpoint:  return "midpoint";
+        default:                   return "optimal";
+    }
+}
+
+// Calls fn with std::integral_constant<Placement, P> for the runtime value,
+// turning a command line choice into a compile-time policy.
+template <typename Fn>
+inline void DispatchPlacement(const Placement placement, Fn fn)
+{
+    switch (placement) {
+        case Placement::Endpoints: fn(std::integral_constant<Placement, Placement::Endpoints>{}); break;
+        case Placement::Midpoint:  fn(std::integral_constant<Placement, Placement::Midpoint>{});  break;
+        default:                   fn(std::integral_constant<Placement, Placement::Optimal>{});   break;
+    }
+}
+
+#endif // !QUADRIC_H
@@ -0,0 +1,192 @@
+#ifndef QUADRIC_BATCH_H
+#define QUADRIC_BATCH_H
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "quadric.h"
+
+// Batched QEM kernels over structure-of-arrays blocks. The callers gather a
+// block of elements into lane arrays, the kernels run the arithmetic as
+// omp simd loops and are cloned for AVX-512, AVX2 and the baseline ISA, the
+// best clone is picked at load time from the running CPU. Branches are
+// written as selects, the build uses -fno-math-errno -fno-trapping-math so
+// sqrt and divisions can be if-converted without AVX-512 masks.
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    #define QEM_TARGET_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+    #define QEM_TARGET_CLONES
+#endif
+
+// Elements per block, a few full AVX-512 vectors of floats
+constexpr uint32_t QUADRIC_BLOCK = 64;
+
+// Corner positions of up to QUADRIC_BLOCK faces, mX[k][i] is the x of the
+// k-th corner of the i-th face.
+struct FaceBlock {
+    alignas(64) float mX[3][QUADRIC_BLOCK];
+    alignas(64) float mY[3][QUADRIC_BLOCK];
+    alignas(64) float mZ[3][QUADRIC_BLOCK];
+};
+
+// Plane quadrics of the faces of the block, same steps as EvaluateFacePlane
+// + SymQuadric::FromPlane (unit normal and offset in float, products in
+// T) up to float rounding. Degenerate faces get a zero quadric.
+template <typename T>
+QEM_TARGET_CLONES
+inline void ComputeFaceQuadrics(const FaceBlock& block, const uint32_t count, SymQuadricT<T>* out)
+{
+    alignas(64) float pa[QUADRIC_BLOCK], pb[QUADRIC_BLOCK], pc[QUADRIC_BLOCK], pd[QUADRIC_BLOCK];
+
+    #pragma omp simd aligned(pa, pb, pc, pd : 64)
+    for (uint32_t i = 0; i < count; ++i) {
+        const float ux = block.mX[1][i] - block.mX[0][i];
+        const float uy = block.mY[1][i] - block.mY[0][i];
+        const float uz = block.mZ[1][i] - block.mZ[0][i];
+        const float vx = block.mX[2][i] - block.mX[0][i];
+        const float vy = block.mY[2][i] - block.mY[0][i];
+        const float vz = block.mZ[2][i] - block.mZ[0][i];
+
+        float nx = uy * vz - uz * vy;
+        float ny = uz * vx - ux * vz;
+        float nz = ux * vy - uy * vx;
+
+        const float norm2 = nx * nx + ny * ny + nz * nz;
+        // Degenerate faces keep their zero normal
+        const float invNorm = 1.0f / std::sqrt(std::max(norm2, FLT_MIN));
+        nx *= invNorm;
+        ny *= invNorm;
+        nz *= invNorm;
+
+        pa[i] = nx;
+        pb[i] = ny;
+        pc[i] = nz;
+        pd[i] = -(nx * block.mX[0][i] + ny * block.mY[0][i] + nz * block.mZ[0][i]);
+    }
+
+    #pragma omp simd
+    for (uint32_t i = 0; i < count; ++i) {
+        const T a = pa[i], b = pb[i], c = pc[i], d = pd[i];
+        T* m = out[i].m.data();
+        m[0] = a * a; m[1] = a * b; m[2] = a * c; m[3] = a * d;
+                      m[4] = b * b; m[5] = b * c; m[6] = b * d;
+                                    m[7] = c * c; m[8] = c * d;
+                                                  m[9] = d * d;
+    }
+}
+
+// Summed quadrics and endpoints of up to QUADRIC_BLOCK edges, mQ[j][i] is
+// coefficient j of the i-th edge and mP[0] / mP[1] its two endpoints.
+template <typename T>
+struct EdgeBlockT {
+    alignas(64) T mQ[10][QUADRIC_BLOCK];
+    alignas(64) T mP[2][3][QUADRIC_BLOCK];
+};
+
+template <typename T>
+struct EdgeSolutionT {
+    alignas(64) T     mError[QUADRIC_BLOCK];
+    alignas(64) float mX[QUADRIC_BLOCK];
+    alignas(64) float mY[QUADRIC_BLOCK];
+    alignas(64) float mZ[QUADRIC_BLOCK];
+};
+
+using EdgeBlock    = EdgeBlockT<QuadricScalar>;
+using EdgeSolution = EdgeSolutionT<QuadricScalar>;
+
+// New vertex and error of every edge of the block with the rules of
+// EvaluateNewBestVertex<P>. Optimal takes the closed-form solution of the
+// 3x3 system when it passes the singularity test of SymQuadric::Solve,
+// otherwise the best of the endpoints and the midpoint, ties going to the
+// first endpoint, then the second. Every candidate of the policy is
+// computed for every lane and the result is selected, the other policies
+// compile to a fraction of the loop. Returns the lanes where Optimal fell
+// back.
+template <Placement P, typename T>
+QEM_TARGET_CLONES
+inline uint32_t SolveEdgeQuadrics(const EdgeBlockT<T>& block, const uint32_t count, EdgeSolutionT<T>& out,
+                              const T epsilon = T(1e-12))
+{
+    uint32_t fallbacks = 0;
+
+    #pragma omp simd reduction(+:fallbacks)
+    for (uint32_t i = 0; i < count; ++i) {
+        const T m0 = block.mQ[0][i], m1 = block.mQ[1][i], m2 = block.mQ[2][i], m3 = block.mQ[3][i];
+        const T m4 = block.mQ[4][i], m5 = block.mQ[5][i], m6 = block.mQ[6][i];
+        const T m7 = block.mQ[7][i], m8 = block.mQ[8][i], m9 = block.mQ[9][i];
+
+        auto evaluate = [&](const T x, const T y, const T z) {
+            return x * (m0*x + 2 * (m1*y + m2*z + m3))
+                 + y * (m4*y + 2 * (m5*z + m6))
+                 + z * (m7*z + 2 * m8)
+                 + m9;
+        };
+
+        const T x1 = block.mP[0][0][i], y1 = block.mP[0][1][i], z1 = block.mP[0][2][i];
+        const T x2 = block.mP[1][0][i], y2 = block.mP[1][1][i], z2 = block.mP[1][2][i];
+        const T xm = T(0.5) * (x1 + x2), ym = T(0.5) * (y1 + y2), zm = T(0.5) * (z1 + z2);
+
+        T bx = xm, by = ym, bz = zm;
+        if constexpr (P != Placement::Midpoint) {
+            const T e1 = evaluate(x1, y1, z1);
+            const T e2 = evaluate(x2, y2, z2);
+
+            // Selects are kept one level deep so they turn into vector blends
+            if constexpr (P == Placement::Endpoints) {
+                const bool first = e1 <= e2;
+                bx = first ? x1 : x2;
+                by = first ? y1 : y2;
+                bz = first ? z1 : z2;
+            } else {
+                const T em = evaluate(xm, ym, zm);
+                const bool first  = (e1 <= e2) & (e1 <= em);
+                const bool second = (e2 <= e1) & (e2 <= em);
+
+                bx = second ? x2 : bx;
+                by = second ? y2 : by;
+                bz = second ? z2 : bz;
+                bx = first ? x1 : bx;
+                by = first ? y1 : by;
+                bz = first ? z1 : bz;
+            }
+        }
+
+        if constexpr (P == Placement::Optimal) {
+            const T c00 = m4*m7 - m5*m5;
+            const T c01 = m2*m5 - m1*m7;
+            const T c02 = m1*m5 - m2*m4;
+            const T c11 = m0*m7 - m2*m2;
+            const T c12 = m1*m2 - m0*m5;
+            const T c22 = m0*m4 - m1*m1;
+
+            const T det = m0 * (m4*m7 - m5*m5)
+                        - m1 * (m1*m7 - m5*m2)
+                        + m2 * (m1*m5 - m4*m2);
+            const T trace = m0 + m4 + m7;
+            const bool solvable = std::fabs(det) > epsilon + SOLVE_RELATIVE_EPSILON<T> * trace * trace * trace;
+            const T invDet = T(1) / det;
+
+            const T sx = -(c00*m3 + c01*m6 + c02*m8) * invDet;
+            const T sy = -(c01*m3 + c11*m6 + c12*m8) * invDet;
+            const T sz = -(c02*m3 + c12*m6 + c22*m8) * invDet;
+
+            bx = solvable ? sx : bx;
+            by = solvable ? sy : by;
+            bz = solvable ? sz : bz;
+            fallbacks += !solvable;
+        }
+
+        out.mError[i] = evaluate(bx, by, bz);
+        out.mX[i] = static_cast<float>(bx);
+        out.mY[i] = static_cast<float>(by);
+        out.mZ[i] = static_cast<float>(bz);
+    }
+
+    return fallbacks;
+}
+
+#endif // !QUADRIC_BATCH_H
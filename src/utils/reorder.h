@@ -0,0 +1,235 @@
+#ifndef REORDER_H
+#define REORDER_H
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "curve_order.h"
+#include "flat_mesh.h"
+#include "mesh.h"
+#include "mesh_io.h"
+#include "quadric.h"
+
+// Space-filling curve reordering. Vertices are sorted by the curve key of
+// their position and faces by the key of their centroid, so elements close
+// in space end up close in memory and the init loops and 1-ring walks of
+// the collapse loop read contiguous records.
+
+constexpr int CURVE_BITS = 21;
+
+// Spreads the low 21 bits of x two zero bits apart
+inline uint64_t ExpandBits(uint64_t x)
+{
+    x &= 0x1FFFFF;
+    x = (x | x << 32) & 0x1F00000000FFFF;
+    x = (x | x << 16) & 0x1F0000FF0000FF;
+    x = (x | x << 8)  & 0x100F00F00F00F00F;
+    x = (x | x << 4)  & 0x10C30C30C30C30C3;
+    x = (x | x << 2)  & 0x1249249249249249;
+    return x;
+}
+
+inline uint64_t MortonCode(const uint32_t x, const uint32_t y, const uint32_t z)
+{
+    return ExpandBits(x) << 2 | ExpandBits(y) << 1 | ExpandBits(z);
+}
+
+// Skilling's transform of the coordinates into the transposed Hilbert index,
+// interleaving the result gives the index along the curve.
+inline uint64_t HilbertCode(uint32_t x, uint32_t y, uint32_t z)
+{
+    uint32_t X[3] = {x, y, z};
+    const uint32_t M = 1u << (CURVE_BITS - 1);
+
+    for (uint32_t Q = M; Q > 1; Q >>= 1) {
+        const uint32_t P = Q - 1;
+        for (int i = 0; i < 3; ++i) {
+            if (X[i] & Q) {
+                X[0] ^= P;
+            } else {
+                const uint32_t t = (X[0] ^ X[i]) & P;
+                X[0] ^= t;
+                X[i] ^= t;
+            }
+        }
+    }
+
+    X[1] ^= X[0];
+    X[2] ^= X[1];
+
+    uint32_t t = 0;
+    for (uint32_t Q = M; Q > 1; Q >>= 1) {
+        if (X[2] & Q) t ^= Q - 1;
+    }
+    for (int i = 0; i < 3; ++i) X[i] ^= t;
+
+    return MortonCode(X[0], X[1], X[2]);
+}
+
+// Quantizes points of the bounding box onto the curve grid
+class CurveKey {
+    CurveOrder mCurve;
+    float mMin[3];
+    float mScale[3];
+
+public:
+    CurveKey(const CurveOrder curve, const float* positions, const std::size_t nVertices)
+        : mCurve(curve)
+    {
+        float lo[3] = {FLT_MAX, FLT_MAX, FLT_MAX}, hi[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+
+        #pragma omp parallel for reduction(min:lo[:3]) reduction(max:hi[:3])
+        for (int64_t v = 0; v < int64_t(nVertices); ++v) {
+            for (int k = 0; k < 3; ++k) {
+                lo[k] = std::min(lo[k], positions[3 * v + k]);
+                hi[k] = std::max(hi[k], positions[3 * v + k]);
+            }
+        }
+
+        const float cells = float((1u << CURVE_BITS) - 1);
+        for (int k = 0; k < 3; ++k) {
+            mMin[k] = lo[k];
+            mScale[k] = hi[k] > lo[k] ? cells / (hi[k] - lo[k]) : 0.0f;
+        }
+    }
+
+    inline uint64_t operator()(const float x, const float y, const float z) const
+    {
+        const float p[3] = {x, y, z};
+        uint32_t q[3];
+        for (int k = 0; k < 3; ++k) {
+            const float cell = std::clamp((p[k] - mMin[k]) * mScale[k], 0.0f, float((1u << CURVE_BITS) - 1));
+            q[k] = static_cast<uint32_t>(cell);
+        }
+        return mCurve == CurveOrder::Hilbert ? HilbertCode(q[0], q[1], q[2]) : MortonCode(q[0], q[1], q[2]);
+    }
+};
+
+// Element ids sorted by key, ties keep the input order
+inline std::vector<uint32_t> SortedOrder(const std::vector<uint64_t>& keys)
+{
+    std::vector<std::pair<uint64_t, uint32_t>> sorted(keys.size());
+
+    #pragma omp parallel for
+    for (int64_t i = 0; i < int64_t(keys.size()); ++i)
+        sorted[i] = {keys[i], uint32_t(i)};
+
+    std::sort(sorted.begin(), sorted.end());
+
+    std::vector<uint32_t> order(keys.size());
+    #pragma omp parallel for
+    for (int64_t i = 0; i < int64_t(keys.size()); ++i)
+        order[i] = sorted[i].second;
+    return order;
+}
+
+// Sorts the vertices and faces of indexed triangle arrays along the curve
+inline void ReorderArrays(const CurveOrder curve, std::vector<float>& positions, std::vector<uint32_t>& indices)
+{
+    if (curve == CurveOrder::None) return;
+
+    const std::size_t nVertices = positions.size() / 3, nFaces = indices.size() / 3;
+    const CurveKey key(curve, positions.data(), nVertices);
+
+    std::vector<uint64_t> keys(nVertices);
+    #pragma omp parallel for
+    for (int64_t v = 0; v < int64_t(nVertices); ++v)
+        keys[v] = key(positions[3 * v], positions[3 * v + 1], positions[3 * v + 2]);
+
+    const auto vertexOrder = SortedOrder(keys);
+    std::vector<uint32_t> remap(nVertices);
+    std::vector<float> sortedPositions(positions.size());
+
+    #pragma omp parallel for
+    for (int64_t i = 0; i < int64_t(nVertices); ++i) {
+        const uint32_t v = vertexOrder[i];
+        remap[v] = uint32_t(i);
+        for (int k = 0; k < 3; ++k) sortedPositions[3 * i + k] = positions[3 * std::size_t(v) + k];
+    }
+    positions.swap(sortedPositions);
+
+    keys.resize(nFaces);
+    #pragma omp parallel for
+    for (int64_t f = 0; f < int64_t(nFaces); ++f) {
+        float c[3] = {0.0f, 0.0f, 0.0f};
+        for (int j = 0; j < 3; ++j) {
+            const uint32_t v = indices[3 * f + j] = remap[indices[3 * f + j]];
+            for (int k = 0; k < 3; ++k) c[k] += positions[3 * std::size_t(v) + k] / 3.0f;
+        }
+        keys[f] = key(c[0], c[1], c[2]);
+    }
+
+    const auto faceOrder = SortedOrder(keys);
+    std::vector<uint32_t> sortedIndices(indices.size());
+
+    #pragma omp parallel for
+    for (int64_t i = 0; i < int64_t(nFaces); ++i) {
+        for (int j = 0; j < 3; ++j) sortedIndices[3 * i + j] = indices[3 * std::size_t(faceOrder[i]) + j];
+    }
+    indices.swap(sortedIndices);
+}
+
+// Locality proxy: misses of a 32 KiB, 8-way LRU cache with 64 byte lines
+// over the per-vertex records (a quadric each) read by a loop over faces.
+inline uint64_t EstimateCacheMisses(const std::vector<uint32_t>& indices,
+                                    const std::size_t vertexBytes = sizeof(SymQuadric))
+{
+    constexpr std::size_t LINE = 64, WAYS = 8, SETS = 64;
+    std::vector<uint64_t> tags(SETS * WAYS, UINT64_MAX);
+    uint64_t misses = 0;
+
+    for (const uint32_t v : indices) {
+        const uint64_t line = uint64_t(v) * vertexBytes / LINE;
+        uint64_t* set = tags.data() + (line % SETS) * WAYS;
+
+        std::size_t way = 0;
+        while (way < WAYS && set[way] != line) ++way;
+        if (way == WAYS) {
+            ++misses;
+            way = WAYS - 1;
+        }
+        // Most recently used line first
+        std::move_backward(set, set + way, set + way + 1);
+        set[0] = line;
+    }
+    return misses;
+}
+
+// Rebuilds the mesh in curve order, element ids change. Deleted elements
+// are dropped, so this is meant to run right after import.
+inline ReorderStats ReorderMesh(Mesh& mesh, const CurveOrder curve)
+{
+    ReorderStats stats;
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    FlattenMesh(mesh, positions, indices);
+
+    stats.mMissesBefore = EstimateCacheMisses(indices);
+    ReorderArrays(curve, positions, indices);
+    stats.mMissesAfter = EstimateCacheMisses(indices);
+
+    BuildMeshFromArrays(mesh, positions.data(), positions.size() / 3, indices.data(), indices.size() / 3);
+    return stats;
+}
+
+inline ReorderStats ReorderMesh(FlatMesh& mesh, const CurveOrder curve)
+{
+    ReorderStats stats;
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    mesh.Flatten(positions, indices);
+
+    stats.mMissesBefore = EstimateCacheMisses(indices);
+    ReorderArrays(curve, positions, indices);
+    stats.mMissesAfter = EstimateCacheMisses(indices);
+
+    mesh.Build(positions.data(), positions.size() / 3, indices.data(), indices.size() / 3);
+    return stats;
+}
+
+#endif // !REORDER_H
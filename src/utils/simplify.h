@@ -0,0 +1,126 @@
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "flat_mesh.h"
+#include "mesh.h"
+
+// Sequential QEM kernel shared by the drivers, templated on the mesh kernel
+// (Mesh or FlatMesh, see the kernel interface in mesh.h). Vertices with the
+// locked status bit are never moved or removed, OpenMesh meshes need vertex,
+// edge, face and halfedge status (PrepareMesh). P is the vertex placement
+// policy of the collapses.
+
+// Quadrics and errors of every element, the heap gets the unlocked edges.
+// The loops are omp parallel for, so they run serially when called from
+// inside another parallel region.
+template <Placement P, typename MeshT>
+inline void InitQuadrics(MeshT& mesh, EdgeHeap& pq)
+{
+    #pragma omp parallel for
+    for (int i = 0; i < NumFaces(mesh); i += QUADRIC_BLOCK) {
+        UpdateFaceQuadrics(mesh, i, std::min<std::size_t>(i + QUADRIC_BLOCK, NumFaces(mesh)));
+    }
+
+    #pragma omp parallel for
+    for (int i = 0; i < NumVertices(mesh); ++i) {
+        UpdateVertexQuadric(mesh, i);
+    }
+
+    #pragma omp parallel for
+    for (int i = 0; i < NumEdges(mesh); i += QUADRIC_BLOCK) {
+        UpdateEdgeErrors<P>(mesh, i, std::min<std::size_t>(i + QUADRIC_BLOCK, NumEdges(mesh)));
+    }
+
+    pq.Resize(NumEdges(mesh));
+    #pragma omp parallel
+    pq.Build(NumEdges(mesh), [&](uint32_t i) {
+        return EdgeError(mesh, i);
+    });
+
+    for (int i = 0; i < NumEdges(mesh); ++i) {
+        if (IsEdgeLocked(mesh, i)) pq.Remove(i);
+    }
+}
+
+// Claim the closed 1-rings of both endpoints of edge e for the current round.
+// Two collapses whose claimed sets are disjoint touch disjoint faces, edges
+// and vertices (quadric refresh and re-scoring included), so they can run
+// concurrently.
+template <typename MeshT>
+inline bool ClaimCollapseNeighborhood(const MeshT& mesh,
+                                      const uint32_t e,
+                                      std::vector<uint32_t>& stamps,
+                                      const uint32_t round)
+{
+    const auto ends = EdgeVertices(mesh, e);
+
+    bool free = true;
+    for (auto v : ends) {
+        free = free && stamps[v] != round;
+        ForEachVertexVertex(mesh, v, [&](uint32_t w) { free = free && stamps[w] != round; });
+    }
+    if (!free) return false;
+
+    for (auto v : ends) {
+        stamps[v] = round;
+        ForEachVertexVertex(mesh, v, [&](uint32_t w) { stamps[w] = round; });
+    }
+    return true;
+}
+
+// Pops the best edge and collapses it when allowed, then re-scores the
+// edges around the survivor. Returns the number of removed faces, 0 when the
+// edge was rejected.
+template <Placement P, typename MeshT>
+inline uint32_t CollapseBestEdge(MeshT& mesh, EdgeHeap& pq, const bool accumulate,
+                                 std::vector<uint32_t>& removed, std::vector<uint32_t>& dirty,
+                                 LoopStats& stats)
+{
+    const uint32_t e = pq.Pop();
+
+    const CollapseCheck check = CheckCollapseEdge(mesh, e);
+    stats.Pop(check);
+    if (check != CollapseCheck::Ok)
+        return 0;
+
+    const uint32_t deletedFaces = 2 - IsBoundaryEdge(mesh, e);
+
+    removed.clear();
+    const uint32_t v = CollapseEdge(mesh, e, removed);
+    for (auto ehd : removed)
+        pq.Remove(ehd);
+
+    dirty.clear();
+    CollectDirtyEdges(mesh, v, accumulate, dirty);
+    stats.mFallbacks += UpdateEdgeErrors<P>(mesh, dirty);
+    stats.mRescored += dirty.size();
+    for (auto ehl : dirty) {
+        if (IsEdgeLocked(mesh, ehl)) continue;
+        pq.Update(ehl, EdgeError(mesh, ehl));
+    }
+
+    return deletedFaces;
+}
+
+// Collapse edges until the mesh has at most target faces or the heap runs
+// out of collapsible edges, returns the number of removed faces.
+template <Placement P, typename MeshT>
+inline uint32_t SimplifySequential(MeshT& mesh, EdgeHeap& pq,
+                                   const uint32_t target, const bool accumulate,
+                                   LoopStats* stats = nullptr)
+{
+    uint32_t deletedFaces = 0;
+    std::vector<uint32_t> removed, dirty;
+    LoopStats local;
+
+    while (NumFaces(mesh) - deletedFaces > target && !pq.Empty())
+        deletedFaces += CollapseBestEdge<P>(mesh, pq, accumulate, removed, dirty, stats ? *stats : local);
+
+    return deletedFaces;
+}
+
+#endif // !SIMPLIFY_H